@@ -0,0 +1,115 @@
+/**
+ * Data structures and operations around arenas: bump pointer allocators whose memory is released all at once.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#ifndef HDB_ARENA_H
+#define HDB_ARENA_H
+
+#include "common.h"
+#include "memory.h"
+
+// The size of the first page of an arena. This is a power of two minus the heap block header,
+// so no memory is lost to the power of two rounding of the heap.
+#define HDB_ARENA_INITIAL_PAGE_SIZE (4096 - HDB_HEAP_PAGE_SIZE)
+
+// All allocations within an arena are aligned to this amount of bytes.
+#define HDB_ARENA_ALIGNMENT 16
+
+/**
+ * Grows the given array to newCount elements. If arena is \c NULL, the array is reallocated on the heap.
+ */
+#define HDB_ARENA_GROW_ARRAY(arena, type, pointer, oldCount, newCount) \
+    ((arena) \
+        ? (type*)hdb_arena_reallocate(arena, pointer, sizeof(type) * (oldCount), sizeof(type) * (newCount)) \
+        : HDB_GROW_ARRAY(type, pointer, newCount))
+
+/**
+ * Frees the given array. If arena is not \c NULL, the memory is only reclaimed when the arena is reset.
+ */
+#define HDB_ARENA_FREE_ARRAY(arena, type, pointer) \
+    ((arena) ? NULL : HDB_FREE_ARRAY(type, pointer))
+
+/**
+ * A page of memory from which an arena hands out allocations. The usable memory directly follows this header.
+ */
+typedef struct hdb_arena_page {
+
+    /**
+     * Pointer to the page that was in use before this one.
+     */
+    struct hdb_arena_page* next;
+
+    /**
+     * The amount of usable bytes in this page.
+     */
+    size_t size;
+
+    /**
+     * The amount of bytes that have been handed out from this page.
+     */
+    size_t used;
+} hdb_arena_page_t;
+
+/**
+ * A bump pointer allocator. All memory allocated from an arena is released at once by \c hdb_arena_reset().
+ */
+typedef struct {
+
+    /**
+     * The page allocations are currently served from, which links to the pages that filled up before it.
+     */
+    hdb_arena_page_t* pages;
+
+    /**
+     * The most recent allocation, which can be grown in place.
+     */
+    void* last;
+} hdb_arena_t;
+
+/**
+ * Initializes the given arena. Must be called before use.
+ *
+ * \param arena The arena to initialize.
+ */
+void hdb_arena_init(hdb_arena_t* arena);
+
+/**
+ * Returns all memory claimed by the given arena to the heap.
+ *
+ * \param arena The arena to free.
+ */
+void hdb_arena_free(hdb_arena_t* arena);
+
+/**
+ * Releases all allocations of the given arena at once. Only the most recent page is kept, so the next cycle of
+ * allocations can be served without claiming memory from the heap.
+ *
+ * \param arena The arena to reset.
+ */
+void hdb_arena_reset(hdb_arena_t* arena);
+
+/**
+ * Allocates \c size bytes of uninitialized memory from the given arena, aligned to \c HDB_ARENA_ALIGNMENT bytes.
+ *
+ * \param arena The arena to allocate from.
+ * \param size The amount of bytes to allocate.
+ * \return A pointer to the newly allocated memory, or \c NULL if \c size is 0 or on failure.
+ */
+void* hdb_arena_allocate(hdb_arena_t* arena, size_t size);
+
+/**
+ * Grows the allocation at \c ptr to \c new_size bytes, preserving its data. The most recent allocation of the
+ * arena is grown in place if its page has room for it. Otherwise the data is copied to a new allocation.
+ * If \c ptr is \c NULL, this is identical to \c hdb_arena_allocate(arena, new_size).
+ *
+ * \param arena The arena \c ptr was allocated from.
+ * \param ptr The allocation to grow.
+ * \param old_size The current size of the allocation in bytes.
+ * \param new_size The requested size of the allocation in bytes.
+ * \return A pointer to the grown allocation, or \c NULL on failure.
+ */
+void* hdb_arena_reallocate(hdb_arena_t* arena, void* ptr, size_t old_size, size_t new_size);
+
+#endif //HDB_ARENA_H
@@ -11,6 +11,12 @@
 #include "line.h"
 #include "value.h"
 
+/**
+ * Decodes the big-endian 24-bit constant index that follows an OP_CONSTANT_LONG opcode.
+ */
+#define HDB_CONSTANT_LONG_INDEX(operand) \
+    (((int32_t)(operand)[0] << 16) | ((int32_t)(operand)[1] << 8) | (int32_t)(operand)[2])
+
 /*!
  * This enum contains all opcodes for the byte code of hdb-ql.
  */
@@ -26,7 +32,7 @@ typedef enum {
     /*!<
      * opcode to read/write a constant \code hdb_value_t\endcode at an index >= 256.
      * Operands:
-     * - int - a 24-bits integer containing the constant value index.
+     * - int - a 24-bits big-endian integer containing the constant value index.
      */
     OP_CONSTANT_LONG,
 
@@ -49,25 +55,25 @@ typedef enum {
     OP_FALSE,
 
      /*!<
-      * opcode to push the value -1.0 on the stack.
+      * opcode to push the integer -1 on the stack.
       * Operands: none
       */
      OP_MINUS_ONE,
 
      /*!<
-      * opcode to push the value 0.0 on the stack.
+      * opcode to push the integer 0 on the stack.
       * Operands: none
       */
      OP_ZERO,
 
      /*!<
-      * opcode to push the value 1.0 on the stack.
+      * opcode to push the integer 1 on the stack.
       * Operands: none
       */
      OP_ONE,
 
      /*!<
-      * opcode to push the value 2.0 on the stack.
+      * opcode to push the integer 2 on the stack.
       * Operands: none
       */
      OP_TWO,
@@ -174,6 +180,135 @@ typedef enum {
      */
     OP_NEGATE,
 
+    /*!<
+     * opcode to add the constant operand to the value at the top of the stack, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_ADD.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_ADD_CONSTANT,
+
+    /*!<
+     * opcode to subtract the constant operand from the value at the top of the stack, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_SUBTRACT.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_SUBTRACT_CONSTANT,
+
+    /*!<
+     * opcode to multiply the value at the top of the stack by the constant operand, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_MULTIPLY.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_MULTIPLY_CONSTANT,
+
+    /*!<
+     * opcode to divide the value at the top of the stack by the constant operand, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_DIVIDE.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_DIVIDE_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack equals the constant operand, replacing it
+     * with the result.
+     * Behaves like OP_CONSTANT followed by OP_EQUAL.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_EQUAL_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack does not equal the constant operand, replacing it
+     * with the result.
+     * Behaves like OP_CONSTANT followed by OP_NOT_EQUAL.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_NOT_EQUAL_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack is greater than the constant operand, replacing it
+     * with the result.
+     * Behaves like OP_CONSTANT followed by OP_GREATER.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_GREATER_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack is greater than or equal to the constant
+     * operand, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_GREATER_EQUAL.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_GREATER_EQUAL_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack is less than the constant operand, replacing it
+     * with the result.
+     * Behaves like OP_CONSTANT followed by OP_LESS.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_LESS_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the value at the top of the stack is less than or equal to the constant
+     * operand, replacing it with the result.
+     * Behaves like OP_CONSTANT followed by OP_LESS_EQUAL.
+     * Operands:
+     * - byte - the constant value index.
+     */
+    OP_LESS_EQUAL_CONSTANT,
+
+    /*!<
+     * opcode to determine whether the left operand is not greater than the right operand,
+     * which also holds if they cannot be ordered. Behaves like OP_GREATER followed by OP_NOT.
+     * Operands:
+     * - double - the left operand
+     * - double - the right operand
+     */
+    OP_NOT_GREATER,
+
+    /*!<
+     * opcode to determine whether the left operand is not greater than or equal to the right operand,
+     * which also holds if they cannot be ordered. Behaves like OP_GREATER_EQUAL followed by OP_NOT.
+     * Operands:
+     * - double - the left operand
+     * - double - the right operand
+     */
+    OP_NOT_GREATER_EQUAL,
+
+    /*!<
+     * opcode to determine whether the left operand is not less than the right operand,
+     * which also holds if they cannot be ordered. Behaves like OP_LESS followed by OP_NOT.
+     * Operands:
+     * - double - the left operand
+     * - double - the right operand
+     */
+    OP_NOT_LESS,
+
+    /*!<
+     * opcode to determine whether the left operand is not less than or equal to the right operand,
+     * which also holds if they cannot be ordered. Behaves like OP_LESS_EQUAL followed by OP_NOT.
+     * Operands:
+     * - double - the left operand
+     * - double - the right operand
+     */
+    OP_NOT_LESS_EQUAL,
+
+    /*!<
+     * opcode to push the value bound to a statement parameter on the stack, or null if no value is bound.
+     * Operands:
+     * - byte - the zero-based parameter index.
+     */
+    OP_PARAMETER,
+
     /*!<
      * opcode to return the value at the top of the stack to the caller.
      * Operands: none
@@ -215,6 +350,33 @@ typedef struct {
      * The constant values referred to by code within this hdb_chunk_t.
      */
     hdb_value_array_t constants;
+
+    /**
+     * An open addressing hash table of indices into the constants, used to look up a constant by its value.
+     * Empty slots contain -1. Slots that refer to an index beyond the count of the constants are ignored.
+     */
+    int32_t* constant_slots;
+
+    /**
+     * The amount of slots within the constant_slots table. Always zero or a power of two.
+     */
+    int32_t constant_slot_capacity;
+
+    /**
+     * The amount of slots within the constant_slots table that are not empty.
+     */
+    int32_t constant_slot_count;
+
+    /**
+     * The names of the parameters the code within this hdb_chunk_t refers to, by parameter index. Positional
+     * parameters have a null name.
+     */
+    hdb_value_array_t parameters;
+
+    /**
+     * The arena the code, lines and constants are allocated from, or \c NULL to allocate them on the heap.
+     */
+    hdb_arena_t* arena;
 } hdb_chunk_t;
 
 /**
@@ -225,38 +387,106 @@ typedef struct {
 void hdb_chunk_init(hdb_chunk_t *chunk);
 
 /**
- * Returns the memory claimed by the given hdb_chunk_t to the heap.
+ * Initializes the given hdb_chunk_t, allocating its code, lines, constants and parameters from the given arena.
+ * Must be called before use.
+ *
+ * \param chunk The pointer to the hdb_chunk_t to be initialized.
+ * \param arena The arena to allocate from.
+ */
+void hdb_chunk_init_arena(hdb_chunk_t *chunk, hdb_arena_t *arena);
+
+/**
+ * Returns the memory claimed by the given hdb_chunk_t to the heap. If the chunk uses an arena, its memory is
+ * reclaimed when that arena is reset.
  *
  * \param chunk The pointer to the hdb_chunk_t to be freed.
  */
 void hdb_chunk_free(hdb_chunk_t *chunk);
 
+/**
+ * Copies the code, lines, constants, constant slots and parameters of the source chunk into the destination chunk,
+ * which is initialized to allocate them on the heap. This allows a chunk compiled within an arena to outlive the reset
+ * of that arena.
+ *
+ * \param destination The pointer to the hdb_chunk_t to copy to. Any previous contents are not freed.
+ * \param source The hdb_chunk_t to copy.
+ * \return \c true on success, \c false if there was not enough memory, in which case the destination is empty.
+ */
+bool hdb_chunk_copy(hdb_chunk_t *destination, const hdb_chunk_t *source);
+
 /**
  * Stores the instruction in the hdb_chunk_t and encodes the line information.
  *
  * \param chunk The hdb_chunk_t to write to.
  * \param byte The instruction to write.
  * \param line The source code line the instruction originates from.
+ * \return \c true on success, \c false if the chunk could not grow.
+ */
+bool hdb_chunk_write(hdb_chunk_t *chunk, uint8_t byte, int32_t line);
+
+/**
+ * Looks up the index of a constant within the hdb_chunk_t that is identical to the given value. Numbers are only
+ * identical if both their type and their bits are, and strings if their contents are.
+ *
+ * \param chunk The hdb_chunk_t containing the constants.
+ * \param value The constant value to look up.
+ * \return The index of the constant, or -1 if the chunk does not contain it.
  */
-void hdb_chunk_write(hdb_chunk_t *chunk, uint8_t byte, int32_t line);
+int32_t hdb_chunk_find_constant(hdb_chunk_t *chunk, hdb_value_t value);
+
+/**
+ * Stores the hdb_value_t within the constants of the hdb_chunk_t, unless an identical constant is already stored.
+ *
+ * \param chunk The hdb_chunk_t to store the constant in.
+ * \param value The constant value to store.
+ * \return The index of the constant, or -1 if the chunk could not grow.
+ */
+int32_t hdb_chunk_add_constant(hdb_chunk_t *chunk, hdb_value_t value);
 
 /**
  * Stores the hdb_value_t within the hdb_chunk_t and writes the required instructions
- * to retrieve it later.
+ * to retrieve it later. Identical constants share a single index.
  *
  * \param chunk The hdb_chunk_t to write to.
  * \param value The constant value to store.
  * \param line The source code line the constant was introduced.
+ * \return \c true on success, \c false if the chunk could not grow.
  */
-void hdb_chunk_write_constant(hdb_chunk_t *chunk, hdb_value_t value, int32_t line);
+bool hdb_chunk_write_constant(hdb_chunk_t *chunk, hdb_value_t value, int32_t line);
 
 /**
- * Reads a constant value based on the bytecode starting at the given offset.
+ * Reads the constant value an OP_CONSTANT or OP_CONSTANT_LONG instruction refers to.
  *
  * \param chunk The chunk containing the bytecode instructions.
- * \param code_pointer The current pointer to the chunk code.
+ * \param code_pointer The pointer to the first operand byte of the instruction.
  * \return The constant value.
  */
 hdb_value_t hdb_chunk_read_constant(hdb_chunk_t *chunk, uint8_t *code_pointer);
 
+/**
+ * Returns the length in bytes of the instruction at the given offset, including its operands.
+ *
+ * \param chunk The chunk containing the bytecode instructions.
+ * \param offset The offset of the opcode of the instruction.
+ * \return The length of the instruction.
+ */
+int32_t hdb_chunk_instruction_length(const hdb_chunk_t *chunk, int32_t offset);
+
+/**
+ * Replaces the given comparison opcode with the opcode that computes its negation.
+ *
+ * \param opcode The opcode to replace.
+ * \return \c true if the opcode was replaced, \c false if it has no negated counterpart.
+ */
+bool hdb_opcode_negate(uint8_t *opcode);
+
+/**
+ * Looks up the superinstruction that performs the given operation with a constant right-hand operand.
+ *
+ * \param opcode The opcode of the operation.
+ * \param constant_opcode Receives the opcode of the superinstruction.
+ * \return \c true if the operation has a superinstruction, \c false otherwise.
+ */
+bool hdb_opcode_with_constant(uint8_t opcode, uint8_t *constant_opcode);
+
 #endif //HDB_CHUNK_H
\ No newline at end of file
@@ -5,14 +5,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
-/**
- * Causes the debugger to disassemble and print a chunk of code after execution (slow).
+/*
+ * DEBUG_PRINT_CODE causes the compiler to disassemble and print every chunk it compiles (slow).
+ * DEBUG_TRACE_EXECUTION causes the Virtual Machine to start with execution tracing enabled, see hdb_vm_trace().
+ *
+ * Both are defined by the build through the HDB_DEBUG_PRINT_CODE and HDB_DEBUG_TRACE_EXECUTION CMake options,
+ * which are only enabled by default in Debug builds.
  */
-#define DEBUG_PRINT_CODE
-
-/**
- * Causes the debugger to print stack information (slow).
- */
-#define DEBUG_TRACE_EXECUTION
 
 #endif //HDB_COMMON_H
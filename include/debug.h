@@ -26,6 +26,23 @@ void hdb_dbg_disassemble_chunk(hdb_chunk_t* chunk, const char* name);
  */
 int hdb_dbg_disassemble_instruction(hdb_chunk_t* chunk, int32_t offset);
 
+/**
+ * Counts the bytecode instructions within the hdb_chunk_t.
+ *
+ * \param chunk The hdb_chunk_t to count the instructions of.
+ * \return The amount of instructions.
+ */
+int32_t hdb_dbg_instruction_count(hdb_chunk_t* chunk);
+
+/**
+ * Prints the amount of bytecode instructions within the hdb_chunk_t to standard out, next to the amount it
+ * contained before it was optimized.
+ *
+ * \param chunk The optimized hdb_chunk_t.
+ * \param unoptimized_count The amount of instructions before optimizing.
+ */
+void hdb_dbg_print_instruction_counts(hdb_chunk_t* chunk, int32_t unoptimized_count);
+
 /**
  * Prints the given value to standard out.
  *
@@ -33,4 +50,14 @@ int hdb_dbg_disassemble_instruction(hdb_chunk_t* chunk, int32_t offset);
  */
 void hdb_dbg_print_value(hdb_value_t value);
 
+/**
+ * Prints the statistics of the current heap to standard out.
+ */
+void hdb_dbg_print_heap_stats(void);
+
+/**
+ * Prints the statistics of the statement cache of the Virtual Machine to standard out.
+ */
+void hdb_dbg_print_statement_cache_stats(void);
+
 #endif //HDB_DEBUG_H
@@ -8,6 +8,7 @@
 #define HDB_LINE_H
 
 #include "common.h"
+#include "arena.h"
 
 /*!
  * Encoded line information.
@@ -44,17 +45,24 @@ typedef struct {
      * The lines, sorted by line number.
      */
     hdb_line_t* lines;
+
+    /**
+     * The arena to allocate the lines from, or \c NULL to allocate them on the heap.
+     */
+    hdb_arena_t* arena;
 } hdb_line_array_t;
 
 /**
- * Initializes the given array. Must be called before using it.
+ * Initializes the given array. Must be called before using it. The lines are allocated on the heap, unless
+ * an arena is assigned to the array afterwards.
  *
  * \param array The line array to initialize.
  */
 void hdb_line_array_init(hdb_line_array_t* array);
 
 /**
- * Returns the memory claimed by the given hdb_line_array_t to the heap.
+ * Returns the memory claimed by the given hdb_line_array_t to the heap. If the array uses an arena, its memory is
+ * reclaimed when that arena is reset. The arena of the array is kept.
  *
  * \param array The pointer to the hdb_line_array_t to be freed.
  */
@@ -65,7 +73,7 @@ void hdb_line_array_free(hdb_line_array_t* array);
  *
  * \param array The array of lines to encode the given line in.
  * \param line The source code line number.
- * \return The new size of the line array.
+ * \return The new size of the line array, or -1 if the array could not grow.
  */
 int32_t hdb_line_encode(hdb_line_array_t* array, int32_t line);
 
@@ -78,4 +86,13 @@ int32_t hdb_line_encode(hdb_line_array_t* array, int32_t line);
  */
 int32_t hdb_line_decode(hdb_line_array_t* array, int32_t instruction_index);
 
+/**
+ * Drops the lines of all instructions at or after the given instruction index, for example after the trailing
+ * instructions of a chunk have been replaced.
+ *
+ * \param array The line array containing the encoded lines.
+ * \param instruction_count The amount of instructions to keep the lines of.
+ */
+void hdb_line_truncate(hdb_line_array_t* array, int32_t instruction_count);
+
 #endif //HDB_LINE_H
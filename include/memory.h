@@ -7,6 +7,8 @@
 #ifndef HDB_MEMORY_H
 #define HDB_MEMORY_H
 
+#include <pthread.h>
+
 #include "common.h"
 
 #define HDB_ALLOCATE(type, count) \
@@ -21,10 +23,52 @@
 #define HDB_FREE_ARRAY(type, pointer) \
     hdb_reallocate(pointer, 0)
 
-#define HDB_HEAP_INITIAL_MIN_SIZE 8 * 1024 * 1024 // 8MB
+#define HDB_HEAP_INITIAL_MIN_SIZE (8 * 1024 * 1024) // 8MB
 #define HDB_HEAP_PAGE_SIZE sizeof(hdb_memory_block_t)
-#define HDB_HEAP_INCREASE_SIZE 8 * 1024 * 1024 // 8MB
-#define HDB_HEAP_RETURN_BARRIER 8 * 1024 * 1024 // 8MB
+#define HDB_HEAP_INCREASE_SIZE (8 * 1024 * 1024) // 8MB
+
+// Free blocks of at least this size return the pages of freed memory to the OS, and arenas are only unmapped
+// if at least this amount of memory remains free in the heap.
+#define HDB_HEAP_RETURN_BARRIER (8 * 1024 * 1024) // 8MB
+
+// Arenas only reserve their address space up front. Memory is committed in steps of this size, as blocks are
+// carved from the uncommitted end of an arena.
+#define HDB_HEAP_COMMIT_SIZE (1024 * 1024) // 1MB
+
+// The size of the pages backing the heap in HDB_HEAP_HUGE_PAGES mode.
+#define HDB_HEAP_HUGE_PAGE_SIZE (2 * 1024 * 1024) // 2MB
+
+// Heap flags, see hdb_heap_init_flags().
+#define HDB_HEAP_DEFAULT 0x0
+#define HDB_HEAP_HUGE_PAGES 0x1
+
+// Operations recorded in an allocation trace, see hdb_heap_trace_start().
+#define HDB_HEAP_TRACE_MALLOC 1
+#define HDB_HEAP_TRACE_FREE 2
+#define HDB_HEAP_TRACE_REALLOCATE 3
+
+// The amount of trace records buffered in memory before they are written to the trace file.
+#define HDB_HEAP_TRACE_BUFFER_SIZE 1024
+
+// The maximum amount of memory pressure handlers that can be registered with the heap at once.
+#define HDB_HEAP_PRESSURE_HANDLERS 16
+
+// The minimum amount of bytes hdb_malloc_aligned() splits off in front of an aligned block, which fits the header
+// and boundary tag of a free block.
+#define HDB_HEAP_ALIGNED_PADDING (HDB_HEAP_PAGE_SIZE + sizeof(size_t))
+
+// One size class per bit of a size_t. Size class n contains the free blocks with a size in [2^n, 2^(n+1)).
+#define HDB_HEAP_SIZE_CLASSES 64
+
+// Threads attached to the heap cache blocks up to this size class (4KB) locally, so most allocations of a thread
+// don't need to take the heap lock.
+#define HDB_HEAP_CACHE_MAX_CLASS 12
+
+// The amount of blocks a thread cache exchanges with the heap at once when it runs empty or full.
+#define HDB_HEAP_CACHE_BATCH 16
+
+// The maximum amount of blocks a thread cache keeps per size class.
+#define HDB_HEAP_CACHE_CAPACITY (HDB_HEAP_CACHE_BATCH * 2)
 
 #define HDB_MEMORY_PTR(ptr)  \
     ((void*)(ptr) + sizeof(hdb_memory_block_t))
@@ -32,13 +76,26 @@
 #define HDB_BLOCK_PTR(ptr) \
     ((void*)(ptr) - sizeof(hdb_memory_block_t))
 
+// Block sizes are always a multiple of 8, which leaves the lowest bits of the size free to store block flags.
+#define HDB_BLOCK_FREE 0x1
+#define HDB_BLOCK_PREV_FREE 0x2
+#define HDB_BLOCK_FLAGS (HDB_BLOCK_FREE | HDB_BLOCK_PREV_FREE)
+
+#define HDB_BLOCK_SIZE(block) \
+    ((block)->size & ~(size_t)HDB_BLOCK_FLAGS)
+
 /**
  * A header which stores size information about the adjacent blob of data.
+ *
+ * Free blocks also store their size in the last \c size_t of their data (the boundary tag), which allows the block
+ * physically following it to find and merge with it in O(1). The end of each region of heap memory is marked by a
+ * fence block with a size of 0, which is never free.
  */
 typedef struct hdb_memory_block {
 
     /**
-     * The size of the data, including the size of this struct itself.
+     * The size of the data, including the size of this struct itself. The lowest bits contain the
+     * \c HDB_BLOCK_FREE and \c HDB_BLOCK_PREV_FREE flags, use \c HDB_BLOCK_SIZE() to get the actual size.
      */
     size_t size;
 
@@ -53,13 +110,86 @@ typedef struct hdb_memory_block {
     struct hdb_memory_block *prev;
 } hdb_memory_block_t;
 
+/**
+ * A memory pressure handler, which is called when an allocation cannot be satisfied without exceeding the maximum
+ * size of the heap. It should return memory to the heap, for example by evicting caches or spilling data.
+ *
+ * \param size The amount of bytes of the allocation that failed.
+ * \param context The context the handler was registered with.
+ * \return \c true if memory was returned to the heap and the allocation should be retried, \c false otherwise.
+ */
+typedef bool (*hdb_heap_pressure_handler_t)(size_t size, void* context);
+
+/**
+ * A registered memory pressure handler.
+ */
+typedef struct hdb_heap_pressure_entry {
+
+    /**
+     * The function to call under memory pressure.
+     */
+    hdb_heap_pressure_handler_t handler;
+
+    /**
+     * The context to pass to the handler.
+     */
+    void* context;
+
+    /**
+     * The priority of the handler. Handlers with a lower priority run first.
+     */
+    int32_t priority;
+} hdb_heap_pressure_entry_t;
+
+/**
+ * An arena is a single mapping of memory the heap hands out blocks from. Its memory is laid out as follows:
+ *
+ *  ------------------------------------------------------
+ *  |  blocks (size bytes)  |  fence  |  hdb_heap_arena_t  |
+ *  ------------------------------------------------------
+ *
+ * Keeping the arena header behind the fence allows a block which is followed by the fence to find its arena in O(1).
+ *
+ * The mapping is only reserved when the arena is created. Just its first page and the pages containing the fence
+ * and the arena header are committed right away. The remainder is committed front to back, as blocks are carved
+ * from the last block of the arena.
+ */
+typedef struct hdb_heap_arena {
+
+    /**
+     * The amount of bytes available for blocks in this arena.
+     */
+    size_t size;
+
+    /**
+     * The size in bytes of the mapping containing this arena.
+     */
+    size_t mapped_size;
+
+    /**
+     * The amount of bytes at the start of the mapping which have been committed.
+     */
+    size_t committed;
+
+    /**
+     * Pointer to the next arena of the heap.
+     */
+    struct hdb_heap_arena* next;
+
+    /**
+     * Pointer to the previous arena of the heap.
+     */
+    struct hdb_heap_arena* prev;
+} hdb_heap_arena_t;
+
 /**
  * Represents an unmodifiable view of the \c hdb_memory_block_t struct.
  */
 typedef struct hdb_memory_block_view {
 
     /**
-     * The size of the data, including the size of this struct itself.
+     * The size of the data, including the size of this struct itself. The lowest bits contain the
+     * \c HDB_BLOCK_FREE and \c HDB_BLOCK_PREV_FREE flags, use \c HDB_BLOCK_SIZE() to get the actual size.
      */
     const size_t size;
 
@@ -100,16 +230,155 @@ typedef struct hdb_heap {
     size_t current_free;
 
     /**
-     * A pointer to the head of the list of free blocks of memory.
+     * A bitmap of the size classes which currently contain at least one free block. Bit n is set if and only if
+     * \c free_lists[n] is not empty.
+     */
+    uint64_t free_classes;
+
+    /**
+     * The heads of the lists of free blocks of memory, one list per size class.
+     */
+    hdb_memory_block_t* free_lists[HDB_HEAP_SIZE_CLASSES];
+
+    /**
+     * The arenas of this heap, which are unmapped when the heap is destroyed.
+     */
+    hdb_heap_arena_t* arenas;
+
+    /**
+     * Guards all of the above against concurrent modification by threads.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * The \c HDB_HEAP_* flags this heap was initialized with.
+     */
+    const uint32_t flags;
+
+    /**
+     * Per size class, the amount of blocks which have been allocated.
+     */
+    uint64_t allocations[HDB_HEAP_SIZE_CLASSES];
+
+    /**
+     * The highest amount of bytes that have been in use at once.
+     */
+    size_t peak_used;
+
+    /**
+     * The amount of times the heap was grown with a new arena.
+     */
+    uint64_t grow_events;
+
+    /**
+     * The registered memory pressure handlers, sorted by priority.
      */
-    hdb_memory_block_t* free_blocks;
+    hdb_heap_pressure_entry_t pressure_handlers[HDB_HEAP_PRESSURE_HANDLERS];
 
     /**
-     * A pointer to the memory to be freed when the heap is destroyed.
+     * The amount of registered memory pressure handlers.
      */
-    void* free_ptr;
+    int32_t pressure_handler_count;
 } hdb_heap_t;
 
+/**
+ * A single record of an allocation trace. A trace file is a plain sequence of these records, in the byte order of
+ * the machine that recorded it.
+ */
+typedef struct hdb_heap_trace_record {
+
+    /**
+     * The time of the operation in nanoseconds since the trace was started.
+     */
+    uint64_t timestamp;
+
+    /**
+     * The address returned by the operation, or the address that was freed.
+     */
+    uint64_t address;
+
+    /**
+     * The address that was passed to \c hdb_reallocate(), or 0 for other operations.
+     */
+    uint64_t previous;
+
+    /**
+     * The size in bytes that was requested, or 0 for \c hdb_free().
+     */
+    uint64_t size;
+
+    /**
+     * One of the \c HDB_HEAP_TRACE_* operations.
+     */
+    uint8_t operation;
+} hdb_heap_trace_record_t;
+
+/**
+ * A snapshot of the statistics of the heap, as returned by \c hdb_heap_stats().
+ */
+typedef struct hdb_heap_stats {
+
+    /**
+     * The current size in bytes of memory in the heap.
+     */
+    size_t current_size;
+
+    /**
+     * The total amount of memory which is currently free.
+     */
+    size_t current_free;
+
+    /**
+     * The size in bytes of the largest free block, which is the largest allocation possible without growing the heap.
+     */
+    size_t largest_free;
+
+    /**
+     * The external fragmentation of the free memory, which is \c 1 - \c largest_free / \c current_free.
+     * A ratio of 0 means all free memory is in a single block.
+     */
+    double fragmentation;
+
+    /**
+     * The highest amount of bytes that have been in use at once.
+     */
+    size_t peak_used;
+
+    /**
+     * The amount of times the heap was grown with a new arena.
+     */
+    uint64_t grow_events;
+
+    /**
+     * Per size class, the amount of blocks which have been allocated. Size class n contains blocks with a size
+     * in [2^n, 2^(n+1)).
+     */
+    uint64_t allocations[HDB_HEAP_SIZE_CLASSES];
+} hdb_heap_stats_t;
+
+/**
+ * A cache of allocated blocks owned by a single thread. Blocks in a thread cache are still in use as far as the
+ * heap is concerned, so they are neither merged with their neighbours nor counted as free memory.
+ */
+typedef struct hdb_heap_cache {
+
+    /**
+     * Per size class, a list of cached blocks linked through their \c next pointer.
+     */
+    hdb_memory_block_t* bins[HDB_HEAP_CACHE_MAX_CLASS + 1];
+
+    /**
+     * Per size class, the amount of blocks in the related bin.
+     */
+    uint16_t counts[HDB_HEAP_CACHE_MAX_CLASS + 1];
+
+    /**
+     * Per size class, the amount of allocations served from this cache which have not been added to the
+     * statistics of the heap yet.
+     */
+    uint64_t allocations[HDB_HEAP_CACHE_MAX_CLASS + 1];
+} hdb_heap_cache_t;
+
 /**
  * An unmodifiable view of the \c hdb_heap_t struct.
  */
@@ -136,9 +405,15 @@ typedef struct hdb_heap_view {
     const size_t current_free;
 
     /**
-     * A pointer to the head of the list of free blocks of memory.
+     * A bitmap of the size classes which currently contain at least one free block. Bit n is set if and only if
+     * \c free_lists[n] is not empty.
+     */
+    const uint64_t free_classes;
+
+    /**
+     * The heads of the lists of free blocks of memory, one list per size class.
      */
-    hdb_memory_block_view_t* free_blocks;
+    hdb_memory_block_view_t* const free_lists[HDB_HEAP_SIZE_CLASSES];
 } hdb_heap_view_t;
 
 /**
@@ -146,6 +421,7 @@ typedef struct hdb_heap_view {
  * is retrieved from this heap. The initial size of the heap is \c min_size. If the heap has been initialized before,
  * this method just returns a pointer to that heap.
  * If an error occurs during initialization, this method returns \c NULL and sets \c errno accordingly.
+ * Once initialized, the heap can be used from multiple threads at once.
  *
  * \param min_size The minimum size of the heap in bytes, must be >= (HDB_HEAP_PAGE_SIZE * 3).
  * \param max_size The maximum size of the heap in bytes, must be larger than \c min_size.
@@ -153,15 +429,76 @@ typedef struct hdb_heap_view {
  */
 hdb_heap_view_t* hdb_heap_init(size_t min_size, size_t max_size);
 
+/**
+ * Initializes the heap like \c hdb_heap_init(), using the given flags.
+ *
+ * With \c HDB_HEAP_HUGE_PAGES, arenas are backed by explicit 2MB huge pages if the system has them available.
+ * Otherwise arenas are aligned to 2MB and the OS is advised to back them with transparent huge pages, and memory is
+ * committed in 2MB steps to keep those pages intact. This reduces TLB misses on large heaps, at the cost of
+ * committing memory in larger steps.
+ *
+ * \param min_size The minimum size of the heap in bytes, must be >= (HDB_HEAP_PAGE_SIZE * 3).
+ * \param max_size The maximum size of the heap in bytes, must be larger than \c min_size.
+ * \param flags A bitwise or of \c HDB_HEAP_* flags, or \c HDB_HEAP_DEFAULT.
+ * \return: A non-modifiable view of the heap.
+ */
+hdb_heap_view_t* hdb_heap_init_flags(size_t min_size, size_t max_size, uint32_t flags);
+
 /**
  * \return A non-modifiable view of the current heap.
  */
 hdb_heap_view_t* hdb_heap(void);
 
 /**
- * Merges contiguous free blocks into a single block.
+ * Takes a snapshot of the statistics of the current heap. Keeping the statistics costs a few counter updates per
+ * allocation, so they are always enabled. Allocations served by thread caches are counted once the cache next
+ * exchanges blocks with the heap, or when the thread detaches.
+ *
+ * \param stats The snapshot to fill.
+ * \return \c true on success, \c false if the heap has not been initialized.
+ */
+bool hdb_heap_stats(hdb_heap_stats_t* stats);
+
+/**
+ * Registers a memory pressure handler with the current heap. When an allocation cannot be satisfied, the heap first
+ * returns the blocks in the cache of the calling thread. Then it calls the registered handlers in ascending order of
+ * priority, and retries the allocation after each handler that returned memory. Only if all of them fail, the
+ * allocation fails. Handlers with an equal priority run in order of registration. A handler may allocate memory
+ * itself, but that never triggers the pressure handlers again.
+ *
+ * \param handler The function to call under memory pressure.
+ * \param context The context to pass to the handler.
+ * \param priority The priority of the handler. Cheap handlers, like cache eviction, should use a low priority.
+ * \return \c true on success, \c false if the heap has not been initialized (\c errno is \c EINVAL) or
+ * \c HDB_HEAP_PRESSURE_HANDLERS handlers are registered already (\c errno is \c ENOMEM).
+ */
+bool hdb_heap_pressure_register(hdb_heap_pressure_handler_t handler, void* context, int32_t priority);
+
+/**
+ * Unregisters the memory pressure handler that was registered with the given function and context. If no such
+ * handler is registered, no operation is performed.
+ *
+ * \param handler The function of the handler.
+ * \param context The context of the handler.
+ */
+void hdb_heap_pressure_unregister(hdb_heap_pressure_handler_t handler, void* context);
+
+/**
+ * Starts recording every call to \c hdb_malloc(), \c hdb_free() and \c hdb_reallocate() to the trace file at the
+ * given path, which is truncated first. Records are buffered and written in batches. A trace that is already being
+ * recorded is stopped first. The trace can be replayed against other allocators with the \c hdb_heap_replay tool.
+ *
+ * \param path The path of the trace file.
+ * \return \c true on success, \c false if the heap has not been initialized or the file cannot be opened, in
+ * which case \c errno is set.
  */
-void hdb_heap_compact(void);
+bool hdb_heap_trace_start(const char* path);
+
+/**
+ * Writes the buffered records to the trace file and stops recording. If no trace is being recorded, no operation
+ * is performed.
+ */
+void hdb_heap_trace_stop(void);
 
 /**
  * Returns memory claimed by the current heap to the underlying OS. This causes all pointers still in use to become
@@ -169,10 +506,31 @@ void hdb_heap_compact(void);
  */
 void hdb_heap_free(void);
 
+/**
+ * Attaches the calling thread to the heap by giving it a cache of small blocks. Small allocations and frees of an
+ * attached thread are served from its cache, which is refilled from and flushed to the heap in batches.
+ * Threads which are not attached share the heap directly. Attaching an already attached thread has no effect.
+ *
+ * \return A pointer to the cache of the calling thread, or \c NULL if the heap has not been initialized.
+ */
+hdb_heap_cache_t* hdb_heap_thread_attach(void);
+
+/**
+ * Detaches the calling thread from the heap and returns all blocks in its cache to the heap. Every attached thread
+ * must detach before it exits, and before \c hdb_heap_free() is called.
+ */
+void hdb_heap_thread_detach(void);
+
+/**
+ * \return The cache of the calling thread, or \c NULL if it is not attached to the heap.
+ */
+hdb_heap_cache_t* hdb_heap_thread_cache(void);
+
 /**
  * Allocates a new block of uninitialized memory of at least size bytes, aligned to \c HDB_HEAP_PAGE_SIZE bytes.
  * This alignment is to prevent overhead when memory blocks would otherwise have a size less than the related header.
- * If the requested amount of bytes cannot be allocated, \c hdb_malloc returns \c NULL and \c errno is set accordingly.
+ * If the requested amount of bytes cannot be allocated, even after running the memory pressure handlers,
+ * \c hdb_malloc returns \c NULL and \c errno is set to \c ENOMEM.
  *
  * \c hdb_malloc() also returns \c NULL when \c size is \c 0. To differentiate between a possible memory allocation
  * failure and this valid case, check the value of \c errno if \c NULL is returned.
@@ -182,8 +540,21 @@ void hdb_heap_free(void);
  */
 void* hdb_malloc(size_t size);
 
+/**
+ * Allocates a new block of uninitialized memory of at least size bytes, aligned to \c alignment bytes. This allows
+ * aligned vector loads, and keeps hot structures from sharing a cache line. The memory is freed using \c hdb_free().
+ * If the memory is grown using \c hdb_reallocate(), it is only guaranteed to remain aligned if it grows in place.
+ *
+ * \param size The minimum amount of bytes to allocate.
+ * \param alignment The alignment in bytes, which must be a power of two.
+ * \return A pointer to the newly allocated memory, or \c NULL if \c size is 0 or on failure, in which case
+ * \c errno is set to \c EINVAL if \c alignment is not a power of two, or to \c ENOMEM otherwise.
+ */
+void* hdb_malloc_aligned(size_t size, size_t alignment);
+
 /**
  * Frees the memory space pointed to by ptr, which must have been returned by previous call to \c hdb_malloc().
+ * The freed block is merged with its physically adjacent free blocks right away.
  * Otherwise, or if \c hdb_free(ptr) has already been called before, undefined behaviour occurs. If \c ptr is \c NULL,
  * no operation is performed.
  *
@@ -193,8 +564,9 @@ void hdb_free(void* ptr);
 
 /**
  * Allocates \c new_size bytes of memory preserving and returns a pointer to it. The data in
- * \c ptr is preserved. If new memory must be allocated but it fails, this method returns \c NULL and
- * \c errno is set accordingly.
+ * \c ptr is preserved. If the block of \c ptr is followed by a free block which is large enough, the block is
+ * grown in place. Otherwise the data is moved to a new block and \c ptr is freed. If new memory must be allocated
+ * but it fails, this method returns \c NULL, \c ptr is left untouched and \c errno is set accordingly.
  * If a @param ptr of @c NULL is provided, the implementation is identical to a call to hdb_malloc(new_size).
  * If a @param new_size of 0 is provided, the given pointer is hdb_free()'d.
  *
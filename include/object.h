@@ -45,14 +45,22 @@ typedef struct hdb_object {
 } hdb_object_t;
 
 /**
- * Creates a new @c hdb_object_t and notifies the HDB Virtual Machine.
+ * Creates a new @c hdb_object_t in the object pool of the HDB Virtual Machine and notifies the HDB Virtual Machine.
  *
  * @param size The amount of bytes to allocate for this object.
  * @param type The type of object to create.
- * @return
+ * @return A pointer to the new object, or @c NULL on failure.
  */
 hdb_object_t* hdb_object_create(size_t size, hdb_object_type_t type);
 
+/**
+ * Returns the memory claimed by the given object to the object pool of the HDB Virtual Machine. This does not
+ * remove the object from the object list of the HDB Virtual Machine.
+ *
+ * @param object The object to free.
+ */
+void hdb_object_free(hdb_object_t* object);
+
 static inline bool hdb_is_object_type(hdb_value_t value, hdb_object_type_t type) {
     return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
@@ -37,6 +37,77 @@ void* os_realloc(void* ptr, size_t size);
  */
 void os_free(void* ptr);
 
+/**
+ * \return The size in bytes of a page of virtual memory.
+ */
+size_t os_page_size(void);
+
+/**
+ * Reserves \c size bytes of address space in the current process, without committing any memory to it. The size
+ * must be a multiple of \c os_page_size(). The reserved range cannot be accessed until it is committed using
+ * \c os_commit(). Unlike \c os_malloc(), failure does not terminate the current process.
+ *
+ * \param size The amount of bytes to reserve.
+ * \return A page aligned pointer to the reserved range, or \c NULL on failure, in which case \c errno is set.
+ */
+void* os_reserve(size_t size);
+
+/**
+ * Reserves \c size bytes of address space like \c os_reserve(), but aligns the start of the range to
+ * \c alignment bytes. Both \c size and \c alignment must be a multiple of \c os_page_size().
+ *
+ * \param size The amount of bytes to reserve.
+ * \param alignment The alignment of the reserved range in bytes.
+ * \return An aligned pointer to the reserved range, or \c NULL on failure, in which case \c errno is set.
+ */
+void* os_reserve_aligned(size_t size, size_t alignment);
+
+/**
+ * Maps \c size bytes of readable and writable memory backed by explicit huge pages. The size must be a multiple of
+ * the huge page size of the system. This fails if huge pages are unsupported or none are available.
+ *
+ * \param size The amount of bytes to map.
+ * \return A pointer to the mapped memory, or \c NULL on failure, in which case \c errno is set.
+ */
+void* os_map_huge(size_t size);
+
+/**
+ * Advises the OS to back the given range with transparent huge pages where possible. This has no effect on systems
+ * without transparent huge page support.
+ *
+ * \param ptr The page aligned start of the range.
+ * \param size The size of the range in bytes, which must be a multiple of \c os_page_size().
+ */
+void os_advise_huge(void* ptr, size_t size);
+
+/**
+ * Commits the given page aligned range of reserved address space, which makes it readable and writable. Committed
+ * memory is zero-filled, and is only backed by physical pages once it is accessed.
+ *
+ * \param ptr The page aligned start of the range.
+ * \param size The size of the range in bytes, which must be a multiple of \c os_page_size().
+ * \return 0 on success, nonzero on failure, in which case \c errno is set.
+ */
+int32_t os_commit(void* ptr, size_t size);
+
+/**
+ * Removes the mapping of \c size bytes at the given address, which must have been returned by \c os_reserve().
+ * This returns the memory to the underlying OS.
+ *
+ * \param ptr The start of the mapping.
+ * \param size The size of the mapping in bytes.
+ */
+void os_unmap(void* ptr, size_t size);
+
+/**
+ * Returns the physical pages backing the given page aligned range to the underlying OS, while keeping the range
+ * mapped. The next access to the range yields zero-filled pages.
+ *
+ * \param ptr The page aligned start of the range.
+ * \param size The size of the range in bytes, which must be a multiple of \c os_page_size().
+ */
+void os_release(void* ptr, size_t size);
+
 /**
  * Sends the given signal to the calling process or thread.
  * \param signal The signal to send.
@@ -0,0 +1,30 @@
+/**
+ * A peephole optimizer that rewrites short instruction sequences of a compiled hdb_chunk_t into cheaper ones.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#ifndef HDB_PEEPHOLE_H
+#define HDB_PEEPHOLE_H
+
+#include "chunk.h"
+
+/**
+ * Rewrites redundant instruction sequences within the given chunk and rebuilds its line information, so every
+ * remaining instruction keeps the line it originates from. Because chunks do not contain jumps, any sequence of
+ * instructions can be rewritten.
+ *
+ * The following sequences are rewritten:
+ * - \c OP_NOT of \c OP_TRUE or \c OP_FALSE becomes the opposite boolean.
+ * - \c OP_NOT \c OP_NOT after an instruction that produces a boolean is removed.
+ * - \c OP_NOT of a comparison becomes the negated comparison, like \c OP_EQUAL \c OP_NOT becomes \c OP_NOT_EQUAL.
+ * - \c OP_NEGATE of a numeric constant becomes the negated constant.
+ * - An operation on a constant right-hand operand becomes a superinstruction.
+ *
+ * \param chunk The compiled chunk to optimize.
+ * \return \c true on success, \c false if there was not enough memory, in which case the code and lines of the
+ * chunk are left untouched.
+ */
+bool hdb_peephole_optimize(hdb_chunk_t* chunk);
+
+#endif //HDB_PEEPHOLE_H
@@ -16,7 +16,7 @@ typedef enum {
     TOKEN_COLON, TOKEN_SEMICOLON, TOKEN_LESS_THAN, TOKEN_EQUALS, TOKEN_NOT_EQUAL, TOKEN_LESS_EQUAL, TOKEN_GREATER_EQUAL,
     TOKEN_GREATER_THAN, TOKEN_QUESTION_MARK, TOKEN_LEFT_BRACKET, TOKEN_RIGHT_BRACKET, TOKEN_CIRCUMFLEX,
     TOKEN_VERTICAL_BAR, TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE, TOKEN_STRING, TOKEN_IDENTIFIER, TOKEN_ENCLOSED_IDENTIFIER,
-    TOKEN_NUMBER,
+    TOKEN_NUMBER, TOKEN_INTEGER_LITERAL,
 
     TOKEN_ERROR,
 
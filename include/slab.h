@@ -0,0 +1,135 @@
+/**
+ * Data structures and operations around slab pools, which pack small objects of equal size densely into
+ * slabs of heap memory.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#ifndef HDB_SLAB_H
+#define HDB_SLAB_H
+
+#include "common.h"
+#include "memory.h"
+
+// The size in bytes of a single slab. Slabs are aligned to their size, which allows finding the slab of an object
+// by masking its address.
+#define HDB_SLAB_SIZE 4096
+
+// The size in bytes of the heap blocks slabs are carved from. Superblocks are aligned to HDB_SLAB_SIZE, so each of
+// them holds exactly 16 slabs.
+#define HDB_SLAB_SUPERBLOCK_SIZE (16 * HDB_SLAB_SIZE)
+
+// Object sizes are rounded up to a multiple of this amount of bytes.
+#define HDB_SLAB_GRANULARITY 16
+
+// Objects larger than this amount of bytes are allocated on the heap directly.
+#define HDB_SLAB_MAX_OBJECT_SIZE 256
+
+#define HDB_SLAB_CLASSES (HDB_SLAB_MAX_OBJECT_SIZE / HDB_SLAB_GRANULARITY)
+
+#define HDB_SLAB_MAP_WORDS (HDB_SLAB_SIZE / HDB_SLAB_GRANULARITY / 64)
+
+/**
+ * A slab is a page of memory which is divided into slots of equal size. The header is stored at the start of the
+ * slab, directly followed by the slots.
+ */
+typedef struct hdb_slab {
+
+    /**
+     * Pointer to the next slab in the list this slab is on.
+     */
+    struct hdb_slab* next;
+
+    /**
+     * Pointer to the previous slab in the list this slab is on.
+     */
+    struct hdb_slab* prev;
+
+    /**
+     * The size in bytes of each slot in this slab.
+     */
+    uint16_t object_size;
+
+    /**
+     * The amount of slots in this slab.
+     */
+    uint16_t capacity;
+
+    /**
+     * The amount of slots currently in use.
+     */
+    uint16_t used;
+
+    /**
+     * A bitmap of the slots in this slab. Bit n is set if and only if slot n is free.
+     */
+    uint64_t free_map[HDB_SLAB_MAP_WORDS];
+} hdb_slab_t;
+
+/**
+ * A slab pool hands out memory for small objects from slabs, one list of slabs per size class.
+ */
+typedef struct {
+
+    /**
+     * Per size class, the slabs which have at least one free slot.
+     */
+    hdb_slab_t* partial[HDB_SLAB_CLASSES];
+
+    /**
+     * Slabs without any slots in use, which can be reused for any size class.
+     */
+    hdb_slab_t* empty;
+
+    /**
+     * The amount of superblocks the slabs of this pool are carved from.
+     */
+    int32_t superblock_count;
+
+    /**
+     * The current capacity of the superblock array.
+     */
+    int32_t superblock_capacity;
+
+    /**
+     * The heap blocks the slabs of this pool are carved from.
+     */
+    void** superblocks;
+} hdb_slab_pool_t;
+
+/**
+ * Initializes the given slab pool. Must be called before use.
+ *
+ * \param pool The slab pool to initialize.
+ */
+void hdb_slab_pool_init(hdb_slab_pool_t* pool);
+
+/**
+ * Returns all memory claimed by the given slab pool to the heap. This causes all objects allocated from it to
+ * become invalid.
+ *
+ * \param pool The slab pool to free.
+ */
+void hdb_slab_pool_free(hdb_slab_pool_t* pool);
+
+/**
+ * Allocates at least \c size bytes of uninitialized memory from the given pool, aligned to
+ * \c HDB_SLAB_GRANULARITY bytes. Requests larger than \c HDB_SLAB_MAX_OBJECT_SIZE are served by \c hdb_malloc().
+ *
+ * \param pool The pool to allocate from.
+ * \param size The minimum amount of bytes to allocate.
+ * \return A pointer to the newly allocated memory, or \c NULL if \c size is 0 or on failure.
+ */
+void* hdb_slab_alloc(hdb_slab_pool_t* pool, size_t size);
+
+/**
+ * Returns the memory pointed to by \c ptr to the given pool. It must have been returned by a previous call to
+ * \c hdb_slab_alloc() on the same pool, with the same \c size.
+ *
+ * \param pool The pool the memory was allocated from.
+ * \param ptr The pointer to the memory to free.
+ * \param size The size that was requested when allocating the memory.
+ */
+void hdb_slab_free(hdb_slab_pool_t* pool, void* ptr, size_t size);
+
+#endif //HDB_SLAB_H
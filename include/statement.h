@@ -0,0 +1,91 @@
+/**
+ * Prepared statements: a statement is compiled once, and can then be executed any amount of times with other
+ * values bound to its parameters. Parameters are written as \c ? for positional parameters, or as \c :name for
+ * named parameters. Parameters are numbered from 1 in order of their first occurrence, and all occurrences of a
+ * named parameter share a single number.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#ifndef HDB_STATEMENT_H
+#define HDB_STATEMENT_H
+
+#include "chunk.h"
+#include "vm.h"
+
+/**
+ * A compiled statement, together with the values bound to its parameters.
+ */
+typedef struct {
+
+    /**
+     * The compiled statement, allocated on the heap.
+     */
+    hdb_chunk_t chunk;
+
+    /**
+     * The values bound to the parameters of the statement, by zero-based parameter index. Unbound parameters are
+     * null.
+     */
+    hdb_value_t* parameters;
+} hdb_statement_t;
+
+/**
+ * Compiles the given source code into a new prepared statement. The Virtual Machine must be initialized.
+ *
+ * \param source The source code of the statement.
+ * \return The prepared statement, or \c NULL if compiling failed or there was not enough memory.
+ */
+hdb_statement_t* hdb_statement_prepare(const char* source);
+
+/**
+ * Returns the amount of distinct parameters of the given statement.
+ *
+ * \param statement The prepared statement.
+ * \return The amount of parameters.
+ */
+int32_t hdb_statement_parameter_count(const hdb_statement_t* statement);
+
+/**
+ * Looks up the number of the named parameter with the given name, without the leading colon.
+ *
+ * \param statement The prepared statement.
+ * \param name The name of the parameter.
+ * \return The number of the parameter, or 0 if the statement has no parameter with that name.
+ */
+int32_t hdb_statement_parameter_index(const hdb_statement_t* statement, const char* name);
+
+/**
+ * Binds the given value to a parameter of the statement, until another value is bound to it or the bindings are
+ * cleared. Strings must have been created within the Virtual Machine that executes the statement.
+ *
+ * \param statement The prepared statement.
+ * \param index The number of the parameter, starting at 1.
+ * \param value The value to bind.
+ * \return \c true on success, \c false if the statement has no parameter with that number.
+ */
+bool hdb_statement_bind(hdb_statement_t* statement, int32_t index, hdb_value_t value);
+
+/**
+ * Resets all parameters of the given statement to null.
+ *
+ * \param statement The prepared statement.
+ */
+void hdb_statement_clear_bindings(hdb_statement_t* statement);
+
+/**
+ * Executes the given statement with the values that are bound to its parameters.
+ *
+ * \param statement The prepared statement.
+ * \return The result state.
+ */
+hdb_interpret_result_t hdb_statement_execute(hdb_statement_t* statement);
+
+/**
+ * Returns the memory claimed by the given statement to the heap.
+ *
+ * \param statement The prepared statement, or \c NULL.
+ */
+void hdb_statement_finalize(hdb_statement_t* statement);
+
+#endif //HDB_STATEMENT_H
@@ -0,0 +1,197 @@
+/**
+ * A least recently used cache of compiled statements, so that executing the same statement again skips compiling
+ * it. Statements are looked up by their normalized token stream: whitespace and comments within a line do not
+ * make two statements different.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#ifndef HDB_STATEMENT_CACHE_H
+#define HDB_STATEMENT_CACHE_H
+
+#include <pthread.h>
+
+#include "common.h"
+#include "chunk.h"
+
+// The default amount of compiled statements the cache of the Virtual Machine holds.
+#define HDB_STATEMENT_CACHE_CAPACITY 512
+
+/**
+ * A compiled statement within a hdb_statement_cache_t.
+ */
+typedef struct hdb_cached_statement {
+
+    /**
+     * The statement that was used more recently than this one, or \c NULL if this is the most recent one.
+     */
+    struct hdb_cached_statement* prev;
+
+    /**
+     * The statement that was used less recently than this one, or \c NULL if this is the least recent one.
+     */
+    struct hdb_cached_statement* next;
+
+    /**
+     * The next statement within the same bucket.
+     */
+    struct hdb_cached_statement* chain;
+
+    /**
+     * The hash of the key.
+     */
+    uint64_t hash;
+
+    /**
+     * The normalized token stream of the statement.
+     */
+    uint8_t* key;
+
+    /**
+     * The length of the key in bytes.
+     */
+    size_t key_length;
+
+    /**
+     * The compiled statement, allocated on the heap.
+     */
+    hdb_chunk_t chunk;
+} hdb_cached_statement_t;
+
+/**
+ * Structure of a least recently used cache of compiled statements.
+ */
+typedef struct {
+
+    /**
+     * The buckets of the hash table, each containing a chain of statements.
+     */
+    hdb_cached_statement_t** buckets;
+
+    /**
+     * The amount of buckets. Always a power of two.
+     */
+    int32_t bucket_count;
+
+    /**
+     * The most recently used statement.
+     */
+    hdb_cached_statement_t* head;
+
+    /**
+     * The least recently used statement, which is evicted first.
+     */
+    hdb_cached_statement_t* tail;
+
+    /**
+     * The statement that is being executed, which must not be evicted.
+     */
+    hdb_cached_statement_t* pinned;
+
+    /**
+     * The amount of cached statements.
+     */
+    int32_t count;
+
+    /**
+     * The maximum amount of cached statements. A capacity of zero disables the cache.
+     */
+    int32_t capacity;
+
+    /**
+     * The amount of lookups that found a compiled statement.
+     */
+    uint64_t hits;
+
+    /**
+     * The amount of lookups that did not find a compiled statement.
+     */
+    uint64_t misses;
+
+    /**
+     * The amount of statements that were evicted to make room for others, or to relieve memory pressure.
+     */
+    uint64_t evictions;
+
+    /**
+     * The key of the last lookup.
+     */
+    uint8_t* key;
+
+    /**
+     * The length of the key of the last lookup in bytes, or zero if the statement could not be keyed.
+     */
+    size_t key_length;
+
+    /**
+     * The capacity of the key buffer in bytes.
+     */
+    size_t key_capacity;
+
+    /**
+     * The hash of the key of the last lookup.
+     */
+    uint64_t hash;
+
+    /**
+     * The thread that initialized the cache.
+     */
+    pthread_t thread;
+} hdb_statement_cache_t;
+
+/**
+ * Initializes the given cache, and registers a memory pressure handler that evicts its statements.
+ * The cache is not guarded by a lock, so it must only be used by the thread that initializes it. The heap is shared
+ * by all threads, so its pressure handlers can run on any of them, but the handler of the cache only evicts
+ * statements when it runs on that same thread.
+ *
+ * \param cache The cache to initialize.
+ * \param capacity The maximum amount of statements to cache, or zero to disable the cache.
+ * \return \c true on success, \c false if there was not enough memory, in which case the cache is disabled.
+ */
+bool hdb_statement_cache_init(hdb_statement_cache_t* cache, int32_t capacity);
+
+/**
+ * Frees all statements within the given cache, and unregisters its memory pressure handler.
+ *
+ * \param cache The cache to free.
+ */
+void hdb_statement_cache_free(hdb_statement_cache_t* cache);
+
+/**
+ * Looks up the compiled statement for the given source, and marks it as the most recently used one. The source is
+ * scanned to build the key, so this must not be called while compiling.
+ *
+ * \param cache The cache to look in.
+ * \param source The source code of the statement.
+ * \return The compiled statement, or \c NULL if the cache does not contain it.
+ */
+hdb_chunk_t* hdb_statement_cache_lookup(hdb_statement_cache_t* cache, const char* source);
+
+/**
+ * Stores a copy of the given compiled statement under the key of the last lookup, which must have missed. If the
+ * cache is full, the least recently used statement is evicted first.
+ *
+ * \param cache The cache to store the statement in.
+ * \param chunk The compiled statement.
+ * \return The cached copy of the statement, or \c NULL if it was not cached.
+ */
+hdb_chunk_t* hdb_statement_cache_insert(hdb_statement_cache_t* cache, const hdb_chunk_t* chunk);
+
+/**
+ * Pins the given cached statement, so it is not evicted while it executes. Only one statement can be pinned at a
+ * time, and passing \c NULL unpins it.
+ *
+ * \param cache The cache containing the statement.
+ * \param chunk The cached statement to pin, or \c NULL.
+ */
+void hdb_statement_cache_pin(hdb_statement_cache_t* cache, const hdb_chunk_t* chunk);
+
+/**
+ * Evicts all statements from the given cache, except the pinned one. The hit and miss counters are kept.
+ *
+ * \param cache The cache to clear.
+ */
+void hdb_statement_cache_clear(hdb_statement_cache_t* cache);
+
+#endif //HDB_STATEMENT_CACHE_H
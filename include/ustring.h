@@ -45,7 +45,7 @@ typedef struct hdb_ustring {
  * characters. These characters will not be freed.
  *
  * @param chars The source characters to wrap in a @c hdb_ustring_t.
- * @return A pointer to the new @c hdb_ustring_t.
+ * @return A pointer to the new @c hdb_ustring_t, or @c NULL if it could not be allocated.
  */
 const hdb_ustring_t* hdb_ustring_create(const char* chars);
 
@@ -55,7 +55,7 @@ const hdb_ustring_t* hdb_ustring_create(const char* chars);
  *
  * @param chars The source characters to wrap in a @c hdb_ustring_t.
  * @param units The amount of code units to use from the given character array.
- * @return A pointer to the new @c hdb_ustring_t.
+ * @return A pointer to the new @c hdb_ustring_t, or @c NULL if it could not be allocated.
  */
 const hdb_ustring_t* hdb_ustring_ncreate(const char* chars, size_t units);
 
@@ -64,7 +64,7 @@ const hdb_ustring_t* hdb_ustring_ncreate(const char* chars, size_t units);
  *
  * @param left The string to put on the left side.
  * @param right The string to put on the right side.
- * @return The concatenated string.
+ * @return The concatenated string, or @c NULL if it could not be allocated.
  */
 const hdb_ustring_t* hdb_ustring_concatenate(const hdb_ustring_t* left, const hdb_ustring_t* right);
 
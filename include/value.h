@@ -7,17 +7,87 @@
 #ifndef HDB_VALUE_H
 #define HDB_VALUE_H
 
+#include <string.h> // memcpy
+
 #include "common.h"
+#include "arena.h"
 
 typedef struct hdb_object hdb_object_t;
 
+#ifdef HDB_NAN_BOXING
+
+/*
+ * A NaN-boxed value is a double, unless all bits of QNAN are set. Such a quiet NaN is never produced by the FPU,
+ * which leaves its sign bit and lower 50 bits to store an object pointer (sign bit set), a 48-bit integer
+ * (INT_BIT set) or a singleton tag.
+ */
+#define SIGN_BIT            ((uint64_t)0x8000000000000000)
+#define QNAN                ((uint64_t)0x7ffc000000000000)
+#define INT_BIT             ((uint64_t)0x0002000000000000)
+#define INT_MASK            ((uint64_t)0x0000ffffffffffff)
+
+/**
+ * The range of integers a value can hold. Results outside of this range are promoted to doubles.
+ */
+#define HDB_INT_MIN         (-((int64_t)1 << 47))
+#define HDB_INT_MAX         (((int64_t)1 << 47) - 1)
+
+#define TAG_NULL            1
+#define TAG_FALSE           2
+#define TAG_TRUE            3
+
+/**
+ * Type definition for the supported value types in hdb, NaN-boxed into 64 bits.
+ */
+typedef uint64_t hdb_value_t;
+
+#define IS_BOOL(value)      (((value) | 1) == TRUE_VAL)
+#define IS_NULL(value)      ((value) == NULL_VAL)
+#define IS_NUMBER(value)    (((value) & QNAN) != QNAN)
+#define IS_INT(value)       (((value) & (SIGN_BIT | QNAN | INT_BIT)) == (QNAN | INT_BIT))
+#define IS_OBJ(value)       (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+
+#define AS_OBJ(value)       ((hdb_object_t*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+#define AS_BOOL(value)      ((value) == TRUE_VAL)
+#define AS_NUMBER(value)    hdb_value_to_number(value)
+#define AS_INT(value)       (((int64_t)((value) << 16)) >> 16)
+
+#define BOOL_VAL(literal)   ((literal) ? TRUE_VAL : FALSE_VAL)
+#define FALSE_VAL           ((hdb_value_t)(uint64_t)(QNAN | TAG_FALSE))
+#define TRUE_VAL            ((hdb_value_t)(uint64_t)(QNAN | TAG_TRUE))
+#define NULL_VAL            ((hdb_value_t)(uint64_t)(QNAN | TAG_NULL))
+#define NUMBER_VAL(literal) hdb_number_to_value(literal)
+#define INT_VAL(literal)    ((hdb_value_t)(QNAN | INT_BIT | ((uint64_t)(int64_t)(literal) & INT_MASK)))
+#define OBJ_VAL(object)     ((hdb_value_t)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(object)))
+
+static inline double hdb_value_to_number(hdb_value_t value) {
+    double number;
+    memcpy(&number, &value, sizeof(double));
+    return number;
+}
+
+static inline hdb_value_t hdb_number_to_value(double number) {
+    hdb_value_t value;
+    memcpy(&value, &number, sizeof(double));
+    return value;
+}
+
+#else
+
 typedef enum {
     VAL_BOOL,
     VAL_NULL,
     VAL_NUMBER,
+    VAL_INT,
     VAL_OBJ
 } hdb_value_type_t;
 
+/**
+ * The range of integers a value can hold. Results outside of this range are promoted to doubles.
+ */
+#define HDB_INT_MIN         INT64_MIN
+#define HDB_INT_MAX         INT64_MAX
+
 /**
  * Type definition for the supported value types in hdb
  */
@@ -26,24 +96,36 @@ typedef struct {
     union {
         bool boolean;
         double number;
+        int64_t integer;
         hdb_object_t* obj;
     } as;
 } hdb_value_t;
 
 #define IS_BOOL(value)      ((value).type == VAL_BOOL)
-#define IS_NULL (value)     ((value).type == VAL_NULL)
+#define IS_NULL(value)      ((value).type == VAL_NULL)
 #define IS_NUMBER(value)    ((value).type == VAL_NUMBER)
+#define IS_INT(value)       ((value).type == VAL_INT)
 #define IS_OBJ(value)       ((value).type == VAL_OBJ)
 
 #define AS_OBJ(value)       ((value).as.obj)
 #define AS_BOOL(value)      ((value).as.boolean)
 #define AS_NUMBER(value)    ((value).as.number)
+#define AS_INT(value)       ((value).as.integer)
 
 #define BOOL_VAL(literal)   ((hdb_value_t){VAL_BOOL,    {.boolean   = literal}})
 #define NULL_VAL            ((hdb_value_t){VAL_NULL,    {.number    = 0}})
 #define NUMBER_VAL(literal) ((hdb_value_t){VAL_NUMBER,  {.number    = literal}})
+#define INT_VAL(literal)    ((hdb_value_t){VAL_INT,     {.integer   = literal}})
 #define OBJ_VAL(object)     ((hdb_value_t){VAL_OBJ,     {.obj       = (hdb_object_t*)object}})
 
+#endif
+
+/*
+ * Integers and doubles are both numeric. Mixing them promotes the integer to a double.
+ */
+#define IS_NUMERIC(value)   (IS_INT(value) || IS_NUMBER(value))
+#define AS_DOUBLE(value)    (IS_INT(value) ? (double)AS_INT(value) : AS_NUMBER(value))
+
 /**
  * Structure to store multiple values.
  */
@@ -63,6 +145,11 @@ typedef struct {
      * The value array.
      */
     hdb_value_t* values;
+
+    /**
+     * The arena to allocate the values from, or \c NULL to allocate them on the heap.
+     */
+    hdb_arena_t* arena;
 } hdb_value_array_t;
 
 /**
@@ -75,7 +162,8 @@ typedef struct {
 bool hdb_values_equal(hdb_value_t left, hdb_value_t right);
 
 /**
- * Initializes the given array. Must be called before using it.
+ * Initializes the given array. Must be called before using it. The values are allocated on the heap, unless
+ * an arena is assigned to the array afterwards.
  *
  * \param array The value array to be initialized.
  */
@@ -86,11 +174,13 @@ void hdb_init_value_array(hdb_value_array_t* array);
  *
  * \param array The value array to be written to.
  * \param value The value to be written.
+ * \return \c true on success, \c false if the array could not grow, in which case it is left untouched.
  */
-void hdb_write_value_array(hdb_value_array_t* array, hdb_value_t value);
+bool hdb_write_value_array(hdb_value_array_t* array, hdb_value_t value);
 
 /**
- * Returns the memory claimed by the given hdb_value_array_t to the heap.
+ * Returns the memory claimed by the given hdb_value_array_t to the heap. If the array uses an arena, its memory is
+ * reclaimed when that arena is reset. The arena of the array is kept.
  *
  * \param array The array to be freed.
  */
@@ -2,8 +2,10 @@
 #define HDB_VM_H
 
 #include "chunk.h"
+#include "slab.h"
+#include "statement_cache.h"
 
-// Max stack size is 4MB (a pointer to a hdb_value_t uses 8 bytes)
+// Max stack size in values, which is 4MB of NaN-boxed or 8MB of tagged values
 #define HDB_STACK_MAX_SIZE 524288
 
 /**
@@ -61,6 +63,36 @@ typedef struct {
      * A linked list of all objects that have been allocated during the runtime of this Virtual Machine.
      */
     hdb_object_t* objects;
+
+    /**
+     * The slab pool all objects of this Virtual Machine are allocated from.
+     */
+    hdb_slab_pool_t object_pool;
+
+    /**
+     * The arena the chunk of a single compile and execute cycle is allocated from.
+     */
+    hdb_arena_t chunk_arena;
+
+    /**
+     * The compiled statements that were executed most recently.
+     */
+    hdb_statement_cache_t statement_cache;
+
+    /**
+     * The values bound to the parameters of the chunk that is executing.
+     */
+    const hdb_value_t* parameters;
+
+    /**
+     * The amount of values bound to parameters. Parameters beyond this amount are null.
+     */
+    int32_t parameter_count;
+
+    /**
+     * Whether the stack and every instruction are printed while executing.
+     */
+    bool trace;
 } hdb_vm_t;
 
 /**
@@ -104,13 +136,42 @@ void hdb_vm_free(void);
 const hdb_vm_t* hdb_vm(void);
 
 /**
- * Interprets the byte code in the given chunk and returns the result state.
+ * Compiles and executes the given source code and returns the result state. Compiled statements are cached, so
+ * interpreting the same statement again skips compiling it.
  *
  * \param source The source code to interpret.
  * \return The result state.
  */
 hdb_interpret_result_t hdb_vm_interpret(const char* source);
 
+/**
+ * Compiles the given source code into the given chunk, which is initialized to allocate on the heap. If the
+ * statement cache contains the source already, its compiled statement is copied instead.
+ *
+ * \param source The source code to compile.
+ * \param chunk The chunk to compile into. Its previous contents are not freed.
+ * \return \c true on success, \c false if compiling failed or there was not enough memory.
+ */
+bool hdb_vm_compile(const char* source, hdb_chunk_t* chunk);
+
+/**
+ * Executes the byte code in the given, already compiled chunk and returns the result state.
+ *
+ * \param chunk The chunk to execute. It must remain valid until execution finishes.
+ * \param parameters The values bound to the parameters of the chunk, by parameter index, or \c NULL.
+ * \param parameter_count The amount of values within parameters. Parameters beyond this amount are null.
+ * \return The result state.
+ */
+hdb_interpret_result_t hdb_vm_execute(hdb_chunk_t* chunk, const hdb_value_t* parameters, int32_t parameter_count);
+
+/**
+ * Enables or disables printing the stack and every instruction while executing. A Virtual Machine that is not
+ * tracing executes without checking this setting.
+ *
+ * \param enabled Whether to trace execution.
+ */
+void hdb_vm_trace(bool enabled);
+
 /**
  * Pushes the given value onto the stack.
  *
@@ -125,6 +186,11 @@ void hdb_vm_stack_push(hdb_value_t value);
  */
 hdb_value_t hdb_vm_stack_pop(void);
 
+/**
+ * \return The slab pool to allocate objects of the HDB Virtual Machine from.
+ */
+hdb_slab_pool_t* hdb_vm_object_pool(void);
+
 /**
  * Notifies the HDB Virtual Machine of the creation of a new object.
  *
@@ -4,9 +4,11 @@
 
 #include "vm.h"
 #include "os.h"
+#include "debug.h"
 
 static void repl() {
     char line[1024];
+    bool trace = hdb_vm()->trace;
     for (;;) {
         printf("> ");
 
@@ -17,8 +19,26 @@ static void repl() {
 
         // poor man's exit
         if (strncmp(line, ".exit", 5) == 0) { break; }
+        if (strncmp(line, ".heap", 5) == 0) {
+            hdb_dbg_print_heap_stats();
+            continue;
+        }
+        if (strncmp(line, ".cache", 6) == 0) {
+            hdb_dbg_print_statement_cache_stats();
+            continue;
+        }
+        if (strncmp(line, ".trace", 6) == 0) {
+            trace = !trace;
+            hdb_vm_trace(trace);
+            printf("Tracing %s.\n", trace ? "enabled" : "disabled");
+            continue;
+        }
 
-        hdb_vm_interpret(line);
+        if (hdb_vm_interpret(line) == INTERPRET_OK) {
+            const hdb_vm_t* vm = hdb_vm();
+            hdb_dbg_print_value(vm->stack[vm->stack_count]);
+            printf("\n");
+        }
     }
 }
 
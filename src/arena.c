@@ -0,0 +1,121 @@
+#include <string.h> // memcpy
+
+#include "memory.h"
+#include "arena.h"
+
+#define PAGE_DATA(page) \
+    ((char*)(page) + sizeof(hdb_arena_page_t))
+
+/*
+ * Returns the offset within the given page at which an allocation can start.
+ */
+static size_t aligned_offset(hdb_arena_page_t* page) {
+    const uintptr_t address = (uintptr_t)PAGE_DATA(page) + page->used;
+    const uintptr_t aligned = (address + HDB_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(HDB_ARENA_ALIGNMENT - 1);
+
+    return page->used + (aligned - address);
+}
+
+/*
+ * Adds a page which fits at least size bytes to the arena. Pages double in size, so the amount of pages stays
+ * small when a single cycle requires a lot of memory.
+ */
+static hdb_arena_page_t* page_create(hdb_arena_t* arena, size_t size) {
+    // Keep the page size a power of two minus the heap block header.
+    size_t page_size = HDB_ARENA_INITIAL_PAGE_SIZE;
+    if (arena->pages) {
+        page_size = (arena->pages->size + sizeof(hdb_arena_page_t) + HDB_HEAP_PAGE_SIZE) * 2 - HDB_HEAP_PAGE_SIZE;
+    }
+
+    while (page_size - sizeof(hdb_arena_page_t) < size + HDB_ARENA_ALIGNMENT) {
+        page_size = (page_size + HDB_HEAP_PAGE_SIZE) * 2 - HDB_HEAP_PAGE_SIZE;
+    }
+
+    hdb_arena_page_t* page = (hdb_arena_page_t*)hdb_malloc(page_size);
+    if (!page) {
+        return NULL;
+    }
+
+    page->size = page_size - sizeof(hdb_arena_page_t);
+    page->used = 0;
+    page->next = arena->pages;
+    arena->pages = page;
+
+    return page;
+}
+
+void hdb_arena_init(hdb_arena_t* arena) {
+    arena->pages = NULL;
+    arena->last = NULL;
+}
+
+void hdb_arena_free(hdb_arena_t* arena) {
+    while (arena->pages) {
+        hdb_arena_page_t* next = arena->pages->next;
+        hdb_free(arena->pages);
+        arena->pages = next;
+    }
+
+    hdb_arena_init(arena);
+}
+
+void hdb_arena_reset(hdb_arena_t* arena) {
+    if (arena->pages) {
+
+        // Keep the current page, which is the largest one.
+        hdb_arena_page_t* current = arena->pages;
+        arena->pages = current->next;
+        hdb_arena_free(arena);
+
+        current->next = NULL;
+        current->used = 0;
+        arena->pages = current;
+    }
+
+    arena->last = NULL;
+}
+
+void* hdb_arena_allocate(hdb_arena_t* arena, size_t size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    hdb_arena_page_t* page = arena->pages;
+    if (!page || aligned_offset(page) + size > page->size) {
+        page = page_create(arena, size);
+        if (!page) {
+            return NULL;
+        }
+    }
+
+    const size_t offset = aligned_offset(page);
+    page->used = offset + size;
+    arena->last = PAGE_DATA(page) + offset;
+
+    return arena->last;
+}
+
+void* hdb_arena_reallocate(hdb_arena_t* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr) {
+        return hdb_arena_allocate(arena, new_size);
+    } else if (new_size <= old_size) {
+        return ptr;
+    }
+
+    // The most recent allocation ends at the bump pointer of the current page, so it can grow in place.
+    hdb_arena_page_t* page = arena->pages;
+    if (ptr == arena->last) {
+        const size_t offset = (size_t)((char*)ptr - PAGE_DATA(page));
+        if (offset + new_size <= page->size) {
+            page->used = offset + new_size;
+            return ptr;
+        }
+    }
+
+    void* grown = hdb_arena_allocate(arena, new_size);
+    if (grown) {
+        memcpy(grown, ptr, old_size);
+    }
+
+    return grown;
+}
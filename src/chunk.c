@@ -1,6 +1,9 @@
+#include <string.h>
+
 #include "line.h"
 #include "chunk.h"
 #include "memory.h"
+#include "ustring.h"
 
 void hdb_chunk_init(hdb_chunk_t *chunk) {
     chunk->count = 0;
@@ -9,34 +12,242 @@ void hdb_chunk_init(hdb_chunk_t *chunk) {
     chunk->code = NULL;
     hdb_line_array_init(&chunk->lines);
     hdb_init_value_array(&chunk->constants);
+    chunk->constant_slots = NULL;
+    chunk->constant_slot_capacity = 0;
+    chunk->constant_slot_count = 0;
+    hdb_init_value_array(&chunk->parameters);
+    chunk->arena = NULL;
+}
+
+void hdb_chunk_init_arena(hdb_chunk_t *chunk, hdb_arena_t *arena) {
+    hdb_chunk_init(chunk);
+    chunk->arena = arena;
+    chunk->lines.arena = arena;
+    chunk->constants.arena = arena;
+    chunk->parameters.arena = arena;
 }
 
 void hdb_chunk_free(hdb_chunk_t *chunk) {
-    HDB_FREE_ARRAY(uint8_t, chunk->code);
+    HDB_ARENA_FREE_ARRAY(chunk->arena, uint8_t, chunk->code);
     hdb_line_array_free(&chunk->lines);
     hdb_free_value_array(&chunk->constants);
-    hdb_chunk_init(chunk);
+    HDB_ARENA_FREE_ARRAY(chunk->arena, int32_t, chunk->constant_slots);
+    hdb_free_value_array(&chunk->parameters);
+    hdb_chunk_init_arena(chunk, chunk->arena);
 }
 
-void hdb_chunk_write(hdb_chunk_t *chunk, uint8_t byte, int32_t line) {
+bool hdb_chunk_copy(hdb_chunk_t *destination, const hdb_chunk_t *source) {
+    hdb_chunk_init(destination);
+    destination->stack_high_water_mark = source->stack_high_water_mark;
+
+    destination->code = HDB_ALLOCATE(uint8_t, source->count);
+    destination->lines.lines = HDB_ALLOCATE(hdb_line_t, source->lines.count);
+    destination->constants.values = HDB_ALLOCATE(hdb_value_t, source->constants.count);
+    destination->parameters.values = HDB_ALLOCATE(hdb_value_t, source->parameters.count);
+    destination->constant_slots = HDB_ALLOCATE(int32_t, source->constant_slot_capacity);
+    if ((source->count && !destination->code) || (source->lines.count && !destination->lines.lines)
+            || (source->constants.count && !destination->constants.values)
+            || (source->parameters.count && !destination->parameters.values)
+            || (source->constant_slot_capacity && !destination->constant_slots)) {
+        hdb_chunk_free(destination);
+        return false;
+    }
+
+    // Empty arrays are not allocated, and memcpy() does not accept NULL even when copying nothing.
+    if (source->count) {
+        memcpy(destination->code, source->code, source->count);
+        destination->count = destination->capacity = source->count;
+    }
+
+    if (source->lines.count) {
+        memcpy(destination->lines.lines, source->lines.lines, sizeof(hdb_line_t) * source->lines.count);
+        destination->lines.count = destination->lines.capacity = source->lines.count;
+    }
+
+    if (source->constants.count) {
+        memcpy(destination->constants.values, source->constants.values,
+               sizeof(hdb_value_t) * source->constants.count);
+        destination->constants.count = destination->constants.capacity = source->constants.count;
+    }
+
+    if (source->parameters.count) {
+        memcpy(destination->parameters.values, source->parameters.values,
+               sizeof(hdb_value_t) * source->parameters.count);
+        destination->parameters.count = destination->parameters.capacity = source->parameters.count;
+    }
+
+    // Keep interning the constants that are added to the copy. Slots of dropped constants are ignored as usual.
+    if (source->constant_slot_capacity) {
+        memcpy(destination->constant_slots, source->constant_slots, sizeof(int32_t) * source->constant_slot_capacity);
+        destination->constant_slot_capacity = source->constant_slot_capacity;
+        destination->constant_slot_count = source->constant_slot_count;
+    }
+    return true;
+}
+
+bool hdb_chunk_write(hdb_chunk_t *chunk, uint8_t byte, int32_t line) {
     if (chunk->capacity < chunk->count + 1) {
-        int32_t oldCapacity = chunk->capacity;
-        chunk->capacity = HDB_GROW_CAPACITY(oldCapacity);
-        chunk->code = HDB_GROW_ARRAY(uint8_t, chunk->code, chunk->capacity);
+        const int32_t capacity = HDB_GROW_CAPACITY(chunk->capacity);
+        uint8_t* code = HDB_ARENA_GROW_ARRAY(chunk->arena, uint8_t, chunk->code, chunk->capacity, capacity);
+        if (!code) {
+            return false;
+        }
+
+        chunk->code = code;
+        chunk->capacity = capacity;
+    }
+
+    if (hdb_line_encode(&chunk->lines, line) < 0) {
+        return false;
     }
 
     chunk->code[chunk->count] = byte;
-    hdb_line_encode(&chunk->lines, line);
     chunk->count++;
+    return true;
 }
 
-void hdb_chunk_write_constant(hdb_chunk_t *chunk, hdb_value_t value, int32_t line) {
-    hdb_write_value_array(&chunk->constants, value);
-    int32_t idx = chunk->constants.count - 1;
+static uint64_t number_bits(double number) {
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    return bits;
+}
+
+/*
+ * Hashes the given constant consistently with constants_identical().
+ */
+static uint32_t hash_constant(hdb_value_t value) {
+    uint64_t hash;
+
+    if (IS_STRING(value)) {
+        // FNV-1a
+        const hdb_ustring_t* string = AS_STRING(value);
+        uint32_t fnv = 2166136261u;
+        for (size_t i = 0; i < string->byte_length; i++) {
+            fnv ^= (uint8_t)string->chars[i];
+            fnv *= 16777619u;
+        }
+        return fnv;
+    } else if (IS_INT(value)) {
+        hash = (uint64_t)AS_INT(value) ^ 0x9e3779b97f4a7c15;
+    } else if (IS_NUMBER(value)) {
+        hash = number_bits(AS_NUMBER(value));
+    } else if (IS_BOOL(value)) {
+        hash = AS_BOOL(value) ? 3 : 2;
+    } else {
+        hash = 1;
+    }
+
+    // Mix the high bits into the low bits, which select the slot.
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccd;
+    hash ^= hash >> 33;
+    return (uint32_t)hash;
+}
+
+/*
+ * Returns whether two constants can share a slot. Unlike hdb_values_equal(), an integer and a double are never
+ * identical, nor are 0.0 and -0.0.
+ */
+static bool constants_identical(hdb_value_t left, hdb_value_t right) {
+    if (IS_STRING(left) && IS_STRING(right)) {
+        const hdb_ustring_t* l = AS_STRING(left);
+        const hdb_ustring_t* r = AS_STRING(right);
+        return l->byte_length == r->byte_length && memcmp(l->chars, r->chars, l->byte_length) == 0;
+    } else if (IS_INT(left) && IS_INT(right)) {
+        return AS_INT(left) == AS_INT(right);
+    } else if (IS_NUMBER(left) && IS_NUMBER(right)) {
+        return number_bits(AS_NUMBER(left)) == number_bits(AS_NUMBER(right));
+    } else if (IS_BOOL(left) && IS_BOOL(right)) {
+        return AS_BOOL(left) == AS_BOOL(right);
+    }
+
+    return IS_NULL(left) && IS_NULL(right);
+}
+
+/*
+ * Rebuilds the constant slots with the given capacity, which must be a power of two.
+ */
+static bool constant_slots_resize(hdb_chunk_t *chunk, int32_t capacity) {
+    int32_t* slots = HDB_ARENA_GROW_ARRAY(chunk->arena, int32_t, NULL, 0, capacity);
+    if (!slots) {
+        return false;
+    }
+
+    for (int32_t i = 0; i < capacity; i++) {
+        slots[i] = -1;
+    }
+
+    for (int32_t index = 0; index < chunk->constants.count; index++) {
+        uint32_t slot = hash_constant(chunk->constants.values[index]) & (uint32_t)(capacity - 1);
+        while (slots[slot] != -1) {
+            slot = (slot + 1) & (uint32_t)(capacity - 1);
+        }
+        slots[slot] = index;
+    }
+
+    HDB_ARENA_FREE_ARRAY(chunk->arena, int32_t, chunk->constant_slots);
+    chunk->constant_slots = slots;
+    chunk->constant_slot_capacity = capacity;
+    chunk->constant_slot_count = chunk->constants.count;
+    return true;
+}
+
+int32_t hdb_chunk_find_constant(hdb_chunk_t *chunk, hdb_value_t value) {
+    if (chunk->constant_slot_capacity == 0) {
+        return -1;
+    }
+
+    const uint32_t mask = (uint32_t)(chunk->constant_slot_capacity - 1);
+    for (uint32_t slot = hash_constant(value) & mask; chunk->constant_slots[slot] != -1; slot = (slot + 1) & mask) {
+        const int32_t index = chunk->constant_slots[slot];
+        if (index < chunk->constants.count && constants_identical(chunk->constants.values[index], value)) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+int32_t hdb_chunk_add_constant(hdb_chunk_t *chunk, hdb_value_t value) {
+    const int32_t existing = hdb_chunk_find_constant(chunk, value);
+    if (existing >= 0) {
+        return existing;
+    }
+
+    // Keep the table at most three quarters full, so every probe sequence ends at an empty slot.
+    if ((chunk->constant_slot_count + 1) * 4 > chunk->constant_slot_capacity * 3
+            && !constant_slots_resize(chunk, HDB_GROW_CAPACITY(chunk->constant_slot_capacity))) {
+        return -1;
+    }
+
+    if (!hdb_write_value_array(&chunk->constants, value)) {
+        return -1;
+    }
+    const int32_t index = chunk->constants.count - 1;
+
+    // Slots that refer to dropped constants can be reused.
+    const uint32_t mask = (uint32_t)(chunk->constant_slot_capacity - 1);
+    uint32_t slot = hash_constant(value) & mask;
+    while (chunk->constant_slots[slot] != -1 && chunk->constant_slots[slot] < index) {
+        slot = (slot + 1) & mask;
+    }
+
+    if (chunk->constant_slots[slot] == -1) {
+        chunk->constant_slot_count++;
+    }
+    chunk->constant_slots[slot] = index;
+    return index;
+}
+
+bool hdb_chunk_write_constant(hdb_chunk_t *chunk, hdb_value_t value, int32_t line) {
+    const int32_t idx = hdb_chunk_add_constant(chunk, value);
+    if (idx < 0) {
+        return false;
+    }
 
     if (idx < 256) {
-        hdb_chunk_write(chunk, OP_CONSTANT, line);
-        hdb_chunk_write(chunk, (uint8_t) idx, line);
+        return hdb_chunk_write(chunk, OP_CONSTANT, line)
+            && hdb_chunk_write(chunk, (uint8_t) idx, line);
     } else {
         uint8_t array[3] = {
                 (idx >> 16) & 0xff,
@@ -44,25 +255,75 @@ void hdb_chunk_write_constant(hdb_chunk_t *chunk, hdb_value_t value, int32_t lin
                 idx & 0xff
         };
 
-        hdb_chunk_write(chunk, OP_CONSTANT_LONG, line);
-        hdb_chunk_write(chunk, array[0], line);
-        hdb_chunk_write(chunk, array[1], line);
-        hdb_chunk_write(chunk, array[2], line);
+        return hdb_chunk_write(chunk, OP_CONSTANT_LONG, line)
+            && hdb_chunk_write(chunk, array[0], line)
+            && hdb_chunk_write(chunk, array[1], line)
+            && hdb_chunk_write(chunk, array[2], line);
     }
 }
 
 hdb_value_t hdb_chunk_read_constant(hdb_chunk_t *chunk, uint8_t *code_pointer) {
-    const uint8_t op = *(code_pointer - 1);
-
-    if (op == OP_CONSTANT) {
+    if (*(code_pointer - 1) == OP_CONSTANT) {
         return chunk->constants.values[*code_pointer];
     }
 
-    uint8_t b2 = *++code_pointer;
-    uint8_t b1 = *++code_pointer;
-    uint8_t b0 = *code_pointer;
-    uint8_t array[4] = {b0, b1, b2, 0};
+    return chunk->constants.values[HDB_CONSTANT_LONG_INDEX(code_pointer)];
+}
+
+int32_t hdb_chunk_instruction_length(const hdb_chunk_t *chunk, int32_t offset) {
+    switch (chunk->code[offset]) {
+        case OP_CONSTANT_LONG:
+            return 4;
+        case OP_CONSTANT:
+        case OP_PARAMETER:
+        case OP_ADD_CONSTANT:
+        case OP_SUBTRACT_CONSTANT:
+        case OP_MULTIPLY_CONSTANT:
+        case OP_DIVIDE_CONSTANT:
+        case OP_EQUAL_CONSTANT:
+        case OP_NOT_EQUAL_CONSTANT:
+        case OP_GREATER_CONSTANT:
+        case OP_GREATER_EQUAL_CONSTANT:
+        case OP_LESS_CONSTANT:
+        case OP_LESS_EQUAL_CONSTANT:
+            return 2;
+        default:
+            return 1;
+    }
+}
 
-    int32_t index = *(int32_t*)array;
-    return chunk->constants.values[index];
+bool hdb_opcode_negate(uint8_t *opcode) {
+    switch (*opcode) {
+        case OP_EQUAL:              *opcode = OP_NOT_EQUAL; return true;
+        case OP_NOT_EQUAL:          *opcode = OP_EQUAL; return true;
+        case OP_EQUAL_CONSTANT:     *opcode = OP_NOT_EQUAL_CONSTANT; return true;
+        case OP_NOT_EQUAL_CONSTANT: *opcode = OP_EQUAL_CONSTANT; return true;
+        case OP_GREATER:            *opcode = OP_NOT_GREATER; return true;
+        case OP_NOT_GREATER:        *opcode = OP_GREATER; return true;
+        case OP_GREATER_EQUAL:      *opcode = OP_NOT_GREATER_EQUAL; return true;
+        case OP_NOT_GREATER_EQUAL:  *opcode = OP_GREATER_EQUAL; return true;
+        case OP_LESS:               *opcode = OP_NOT_LESS; return true;
+        case OP_NOT_LESS:           *opcode = OP_LESS; return true;
+        case OP_LESS_EQUAL:         *opcode = OP_NOT_LESS_EQUAL; return true;
+        case OP_NOT_LESS_EQUAL:     *opcode = OP_LESS_EQUAL; return true;
+        default:
+            return false;
+    }
+}
+
+bool hdb_opcode_with_constant(uint8_t opcode, uint8_t *constant_opcode) {
+    switch (opcode) {
+        case OP_ADD:            *constant_opcode = OP_ADD_CONSTANT; return true;
+        case OP_SUBTRACT:       *constant_opcode = OP_SUBTRACT_CONSTANT; return true;
+        case OP_MULTIPLY:       *constant_opcode = OP_MULTIPLY_CONSTANT; return true;
+        case OP_DIVIDE:         *constant_opcode = OP_DIVIDE_CONSTANT; return true;
+        case OP_EQUAL:          *constant_opcode = OP_EQUAL_CONSTANT; return true;
+        case OP_NOT_EQUAL:      *constant_opcode = OP_NOT_EQUAL_CONSTANT; return true;
+        case OP_GREATER:        *constant_opcode = OP_GREATER_CONSTANT; return true;
+        case OP_GREATER_EQUAL:  *constant_opcode = OP_GREATER_EQUAL_CONSTANT; return true;
+        case OP_LESS:           *constant_opcode = OP_LESS_CONSTANT; return true;
+        case OP_LESS_EQUAL:     *constant_opcode = OP_LESS_EQUAL_CONSTANT; return true;
+        default:
+            return false;
+    }
 }
@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -6,6 +7,7 @@
 #include "common.h"
 #include "compiler.h"
 #include "scanner.h"
+#include "peephole.h"
 
 #ifdef DEBUG_PRINT_CODE
 #include "debug.h"
@@ -34,6 +36,11 @@ typedef enum {
 
 typedef void (*hdb_parse_fn)();
 
+typedef struct {
+    int32_t offset;
+    int32_t constant_count;
+} hdb_operand_start_t;
+
 typedef struct {
     hdb_parse_fn prefix;
     hdb_parse_fn infix;
@@ -47,6 +54,12 @@ hdb_chunk_t* compiling_chunk;
 uint8_t stack_high_water_mark;
 uint8_t stack_size;
 
+// The offset of the opcode of the instruction that was emitted last.
+int32_t last_instruction;
+
+// Where the left operand of the infix rule that is being parsed starts.
+hdb_operand_start_t left_operand;
+
 #define HDB_DECREASE_STACK_SIZE(amount) stack_size -= amount;
 
 #define HDB_INCREASE_STACK_SIZE(amount) \
@@ -114,13 +127,28 @@ static void consume(hdb_token_type_t type, const char* message) {
     error_at_current(message);
 }
 
+static void emit_operand(uint8_t byte) {
+    if (!hdb_chunk_write(current_chunk(), byte, parser.previous.line)) {
+        error("Out of memory.");
+    }
+}
+
 static void emit_byte(uint8_t byte) {
-    hdb_chunk_write(current_chunk(), byte, parser.previous.line);
+    last_instruction = current_chunk()->count;
+    emit_operand(byte);
 }
 
 static void emit_bytes(uint8_t byte1, uint8_t byte2) {
     emit_byte(byte1);
-    emit_byte(byte2);
+    emit_operand(byte2);
+}
+
+/*
+ * Emits an instruction that pushes a value without an operand, like a literal or a small integer.
+ */
+static void emit_push(uint8_t opcode) {
+    emit_byte(opcode);
+    HDB_INCREASE_STACK_SIZE(1);
 }
 
 static void emit_return(void) {
@@ -128,47 +156,289 @@ static void emit_return(void) {
 }
 
 static void emit_constant(hdb_value_t value) {
-    hdb_chunk_write_constant(current_chunk(), value, parser.current.line);
+    last_instruction = current_chunk()->count;
+    if (!hdb_chunk_write_constant(current_chunk(), value, parser.current.line)) {
+        error("Out of memory.");
+    }
 
     // A constant will get pushed on the stack, using a single slot.
     HDB_INCREASE_STACK_SIZE(1);
 }
 
+/*
+ * Emits the superinstruction of the given operation in place of the last instruction, if that pushes a constant
+ * the superinstruction can refer to. Otherwise, emits the plain opcode.
+ */
+static void emit_operation(uint8_t opcode) {
+    hdb_chunk_t* chunk = current_chunk();
+    const int32_t length = chunk->count - last_instruction;
+    uint8_t constant_opcode;
+
+    if (!hdb_opcode_with_constant(opcode, &constant_opcode)) {
+        emit_byte(opcode);
+        return;
+    }
+
+    if (length == 2 && chunk->code[last_instruction] == OP_CONSTANT) {
+        chunk->code[last_instruction] = constant_opcode;
+        return;
+    }
+
+    // Small integers have their own opcodes, but can be added to the constants as well.
+    if (length == 1 && chunk->code[last_instruction] >= OP_MINUS_ONE && chunk->code[last_instruction] <= OP_TWO) {
+        const hdb_value_t value = INT_VAL((int64_t)chunk->code[last_instruction] - OP_ZERO);
+        int32_t index = hdb_chunk_find_constant(chunk, value);
+        if (index < 0 && chunk->constants.count < 256) {
+            index = hdb_chunk_add_constant(chunk, value);
+        }
+
+        if (index >= 0 && index < 256) {
+            chunk->code[last_instruction] = constant_opcode;
+            emit_operand((uint8_t)index);
+            return;
+        }
+    }
+
+    emit_byte(opcode);
+}
+
+/*
+ * Emits OP_NOT, unless the last instruction is a comparison that can be replaced with its negation.
+ */
+static void emit_not(void) {
+    if (current_chunk()->count == 0 || !hdb_opcode_negate(current_chunk()->code + last_instruction)) {
+        emit_byte(OP_NOT);
+    }
+}
+
 static void end_compiler(void) {
     emit_return();
-#ifdef DEBUG_PRINT_CODE
-    if (!parser.had_error) {
-        hdb_dbg_disassemble_chunk(current_chunk(), "code");
+    if (parser.had_error) {
+        return;
     }
+
+#ifdef DEBUG_PRINT_CODE
+    const int32_t instruction_count = hdb_dbg_instruction_count(current_chunk());
+#endif
+
+    // Without enough memory to optimize, the chunk can still be executed as it is.
+    hdb_peephole_optimize(current_chunk());
+
+#ifdef DEBUG_PRINT_CODE
+    hdb_dbg_disassemble_chunk(current_chunk(), "code");
+    hdb_dbg_print_instruction_counts(current_chunk(), instruction_count);
 #endif
 }
 
+static hdb_operand_start_t operand_start(void) {
+    return (hdb_operand_start_t){
+        .offset = current_chunk()->count,
+        .constant_count = current_chunk()->constants.count
+    };
+}
+
+/*
+ * Reads the value of the operand between the given offsets, if that operand consists of a single instruction that
+ * pushes a constant.
+ */
+static bool constant_operand(int32_t offset, int32_t end, hdb_value_t* value) {
+    hdb_chunk_t* chunk = current_chunk();
+    if (offset >= end || hdb_chunk_instruction_length(chunk, offset) != end - offset) {
+        return false;
+    }
+
+    const uint8_t opcode = chunk->code[offset];
+    switch (opcode) {
+        case OP_CONSTANT:
+        case OP_CONSTANT_LONG:
+            *value = hdb_chunk_read_constant(chunk, chunk->code + offset + 1);
+            return true;
+        case OP_NULL:       *value = NULL_VAL; return true;
+        case OP_TRUE:       *value = BOOL_VAL(true); return true;
+        case OP_FALSE:      *value = BOOL_VAL(false); return true;
+        case OP_MINUS_ONE:
+        case OP_ZERO:
+        case OP_ONE:
+        case OP_TWO:        *value = INT_VAL((int64_t)opcode - OP_ZERO); return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Replaces the code emitted since the given operand start with a single instruction that pushes the given value.
+ * The constants that were added for the replaced code are dropped, and the new instruction keeps the line of the
+ * first instruction it replaces.
+ */
+static void emit_folded(hdb_operand_start_t start, hdb_value_t value) {
+    hdb_chunk_t* chunk = current_chunk();
+    const int32_t line = hdb_line_decode(&chunk->lines, start.offset);
+
+    chunk->count = start.offset;
+    chunk->constants.count = start.constant_count;
+    hdb_line_truncate(&chunk->lines, start.offset);
+
+    uint8_t opcode;
+    if (IS_INT(value) && AS_INT(value) >= -1 && AS_INT(value) <= 2) {
+        opcode = (uint8_t)(OP_ZERO + AS_INT(value));
+    } else if (IS_BOOL(value)) {
+        opcode = AS_BOOL(value) ? OP_TRUE : OP_FALSE;
+    } else if (IS_NULL(value)) {
+        opcode = OP_NULL;
+    } else {
+        last_instruction = chunk->count;
+        if (!hdb_chunk_write_constant(chunk, value, line)) {
+            error("Out of memory.");
+        }
+        return;
+    }
+
+    last_instruction = chunk->count;
+    if (!hdb_chunk_write(chunk, opcode, line)) {
+        error("Out of memory.");
+    }
+}
+
+/*
+ * Evaluates the given binary operation on two constants the way the VM does, including its integer overflow and
+ * division rules. Operations that would raise a runtime error are not folded, so that they still do at runtime.
+ */
+static bool fold_binary(hdb_token_type_t operator_type, hdb_value_t left, hdb_value_t right, hdb_value_t* result) {
+    switch (operator_type) {
+        case TOKEN_EQUALS:      *result = BOOL_VAL(hdb_values_equal(left, right)); return true;
+        case TOKEN_NOT_EQUAL:   *result = BOOL_VAL(!hdb_values_equal(left, right)); return true;
+        case TOKEN_PLUS:
+            if (IS_STRING(left) && IS_STRING(right)) {
+                const hdb_ustring_t* concatenated = hdb_ustring_concatenate(AS_STRING(left), AS_STRING(right));
+                if (!concatenated) {
+                    return false;
+                }
+
+                *result = OBJ_VAL(concatenated);
+                return true;
+            }
+            break;
+        case TOKEN_FORWARD_SLASH:
+            if (IS_NUMERIC(right) && AS_DOUBLE(right) == 0.0) {
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (!IS_NUMERIC(left) || !IS_NUMERIC(right)) {
+        return false;
+    }
+
+    if (IS_INT(left) && IS_INT(right)) {
+        const int64_t l = AS_INT(left);
+        const int64_t r = AS_INT(right);
+        int64_t value;
+        bool overflow;
+
+        switch (operator_type) {
+            case TOKEN_PLUS:            overflow = __builtin_add_overflow(l, r, &value); break;
+            case TOKEN_MINUS:           overflow = __builtin_sub_overflow(l, r, &value); break;
+            case TOKEN_ASTERISK:        overflow = __builtin_mul_overflow(l, r, &value); break;
+            case TOKEN_FORWARD_SLASH:
+                *result = l == HDB_INT_MIN && r == -1 ? NUMBER_VAL(-(double)l) : INT_VAL(l / r);
+                return true;
+            case TOKEN_GREATER_THAN:    *result = BOOL_VAL(l > r); return true;
+            case TOKEN_GREATER_EQUAL:   *result = BOOL_VAL(l >= r); return true;
+            case TOKEN_LESS_THAN:       *result = BOOL_VAL(l < r); return true;
+            case TOKEN_LESS_EQUAL:      *result = BOOL_VAL(l <= r); return true;
+            default:
+                return false;
+        }
+
+        if (!overflow && value >= HDB_INT_MIN && value <= HDB_INT_MAX) {
+            *result = INT_VAL(value);
+            return true;
+        }
+    }
+
+    const double l = AS_DOUBLE(left);
+    const double r = AS_DOUBLE(right);
+    switch (operator_type) {
+        case TOKEN_PLUS:            *result = NUMBER_VAL(l + r); return true;
+        case TOKEN_MINUS:           *result = NUMBER_VAL(l - r); return true;
+        case TOKEN_ASTERISK:        *result = NUMBER_VAL(l * r); return true;
+        case TOKEN_FORWARD_SLASH:   *result = NUMBER_VAL(l / r); return true;
+        case TOKEN_GREATER_THAN:    *result = BOOL_VAL(l > r); return true;
+        case TOKEN_GREATER_EQUAL:   *result = BOOL_VAL(l >= r); return true;
+        case TOKEN_LESS_THAN:       *result = BOOL_VAL(l < r); return true;
+        case TOKEN_LESS_EQUAL:      *result = BOOL_VAL(l <= r); return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Evaluates the given unary operation on a constant the way the VM does, unless it would raise a runtime error.
+ */
+static bool fold_unary(hdb_token_type_t operator_type, hdb_value_t operand, hdb_value_t* result) {
+    switch (operator_type) {
+        case TOKEN_BANG:
+            if (!IS_BOOL(operand)) {
+                return false;
+            }
+
+            *result = BOOL_VAL(!AS_BOOL(operand));
+            return true;
+        case TOKEN_MINUS:
+            if (!IS_NUMERIC(operand)) {
+                return false;
+            } else if (!IS_INT(operand)) {
+                *result = NUMBER_VAL(-AS_NUMBER(operand));
+            } else if (AS_INT(operand) == HDB_INT_MIN) {
+                *result = NUMBER_VAL(-(double)AS_INT(operand));
+            } else {
+                *result = INT_VAL(-AS_INT(operand));
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
 static void expression(void);
 static void parse_precedence(hdb_precedence_t precedence);
 static hdb_parse_rule_t* get_rule(hdb_token_type_t operator_type);
 
 // infix
 static void binary(void) {
-    // Remember the operator
+    // Remember the operator, and where both operands start
     hdb_token_type_t operator_type = parser.previous.type;
+    const hdb_operand_start_t left = left_operand;
+    const hdb_operand_start_t right = operand_start();
 
     // Compile the right-hand operand
     hdb_parse_rule_t* rule = get_rule(operator_type);
     parse_precedence((hdb_precedence_t)(rule->precedence + 1));
 
+    // Binary operators on two constants are evaluated right away.
+    hdb_value_t a, b, folded;
+    if (constant_operand(left.offset, right.offset, &a) && constant_operand(right.offset, current_chunk()->count, &b)
+            && fold_binary(operator_type, a, b, &folded)) {
+        emit_folded(left, folded);
+        HDB_INCREASE_STACK_SIZE(-2); HDB_INCREASE_STACK_SIZE(1);
+        return;
+    }
+
     // Emit the operator instruction.
     // Binary operators first pop() two values off the stack, and push() the result back on to it.
     switch(operator_type) {
-        case TOKEN_NOT_EQUAL:       emit_byte(OP_NOT_EQUAL); break;
-        case TOKEN_EQUALS:          emit_byte(OP_EQUAL); break;
-        case TOKEN_GREATER_THAN:    emit_byte(OP_GREATER); break;
-        case TOKEN_GREATER_EQUAL:   emit_byte(OP_GREATER_EQUAL); break;
-        case TOKEN_LESS_THAN:       emit_byte(OP_LESS); break;
-        case TOKEN_LESS_EQUAL:      emit_byte(OP_LESS_EQUAL); break;
-        case TOKEN_PLUS:            emit_byte(OP_ADD); break;
-        case TOKEN_MINUS:           emit_byte(OP_SUBTRACT); break;
-        case TOKEN_ASTERISK:        emit_byte(OP_MULTIPLY); break;
-        case TOKEN_FORWARD_SLASH:   emit_byte(OP_DIVIDE); break;
+        case TOKEN_NOT_EQUAL:       emit_operation(OP_NOT_EQUAL); break;
+        case TOKEN_EQUALS:          emit_operation(OP_EQUAL); break;
+        case TOKEN_GREATER_THAN:    emit_operation(OP_GREATER); break;
+        case TOKEN_GREATER_EQUAL:   emit_operation(OP_GREATER_EQUAL); break;
+        case TOKEN_LESS_THAN:       emit_operation(OP_LESS); break;
+        case TOKEN_LESS_EQUAL:      emit_operation(OP_LESS_EQUAL); break;
+        case TOKEN_PLUS:            emit_operation(OP_ADD); break;
+        case TOKEN_MINUS:           emit_operation(OP_SUBTRACT); break;
+        case TOKEN_ASTERISK:        emit_operation(OP_MULTIPLY); break;
+        case TOKEN_FORWARD_SLASH:   emit_operation(OP_DIVIDE); break;
         default:
             return; // unreachable
     }
@@ -178,9 +448,9 @@ static void binary(void) {
 
 static void literal(void) {
     switch (parser.previous.type) {
-        case TOKEN_FALSE: emit_byte(OP_FALSE); break;
-        case TOKEN_NULL: emit_byte(OP_NULL); break;
-        case TOKEN_TRUE: emit_byte(OP_TRUE); break;
+        case TOKEN_FALSE: emit_push(OP_FALSE); break;
+        case TOKEN_NULL: emit_push(OP_NULL); break;
+        case TOKEN_TRUE: emit_push(OP_TRUE); break;
         default:
             return; // unreachable
     }
@@ -193,34 +463,105 @@ static void grouping(void) {
 
 static void number(void) {
     double value = strtod(parser.previous.start, NULL);
+    emit_constant(NUMBER_VAL(value));
+}
 
-    if (value == -1.0) {
-        emit_byte(OP_MINUS_ONE);
-    } else if (value == 0.0) {
-        emit_byte(OP_ZERO);
-    } else if (value == 1.0) {
-        emit_byte(OP_ONE);
-    } else if (value == 2.0) {
-        emit_byte(OP_TWO);
+static void integer(void) {
+    errno = 0;
+    long long value = strtoll(parser.previous.start, NULL, 10);
+
+    // An integer literal that does not fit into an integer value becomes a double.
+    if (errno == ERANGE || value > HDB_INT_MAX) {
+        number();
+    } else if (value == 0) {
+        emit_push(OP_ZERO);
+    } else if (value == 1) {
+        emit_push(OP_ONE);
+    } else if (value == 2) {
+        emit_push(OP_TWO);
     } else {
-        emit_constant(NUMBER_VAL(value));
+        emit_constant(INT_VAL(value));
     }
 }
 
 static void string(void) {
-    emit_constant(OBJ_VAL(hdb_ustring_ncreate(parser.previous.start + 1,
-                                      parser.previous.length - 2)));
+    const hdb_ustring_t* ustring = hdb_ustring_ncreate(parser.previous.start + 1, parser.previous.length - 2);
+    if (!ustring) {
+        error("Out of memory.");
+        return;
+    }
+
+    emit_constant(OBJ_VAL(ustring));
+}
+
+/*
+ * Emits the instruction that loads the parameter with the given name, or a new positional parameter if the name is
+ * null. Named parameters that occur more than once share a single index.
+ */
+static void emit_parameter(hdb_value_t name) {
+    hdb_value_array_t* parameters = &current_chunk()->parameters;
+
+    int32_t index = -1;
+    for (int32_t i = 0; !IS_NULL(name) && i < parameters->count; i++) {
+        if (hdb_values_equal(parameters->values[i], name)) {
+            index = i;
+            break;
+        }
+    }
+
+    if (index < 0) {
+        if (parameters->count == 256) {
+            error("Too many parameters in one statement.");
+            return;
+        } else if (!hdb_write_value_array(parameters, name)) {
+            error("Out of memory.");
+            return;
+        }
+
+        index = parameters->count - 1;
+    }
+
+    emit_bytes(OP_PARAMETER, (uint8_t)index);
+    HDB_INCREASE_STACK_SIZE(1);
+}
+
+static void parameter(void) {
+    emit_parameter(NULL_VAL);
+}
+
+static void named_parameter(void) {
+    if (parser.current.type != TOKEN_IDENTIFIER) {
+        error_at_current("Expect parameter name after ':'.");
+        return;
+    }
+    advance();
+
+    const hdb_ustring_t* name = hdb_ustring_ncreate(parser.previous.start, parser.previous.length);
+    if (!name) {
+        error("Out of memory.");
+        return;
+    }
+
+    emit_parameter(OBJ_VAL(name));
 }
 
 static void unary(void) {
     hdb_token_type_t operator_type = parser.previous.type;
+    const hdb_operand_start_t start = operand_start();
 
     // Compile the operand.
     parse_precedence(PREC_UNARY);
 
+    hdb_value_t operand, folded;
+    if (constant_operand(start.offset, current_chunk()->count, &operand)
+            && fold_unary(operator_type, operand, &folded)) {
+        emit_folded(start, folded);
+        return;
+    }
+
     // Emit the operator instruction.
     switch(operator_type) {
-        case TOKEN_BANG:            emit_byte(OP_NOT); break;
+        case TOKEN_BANG:            emit_not(); break;
         case TOKEN_MINUS:           emit_byte(OP_NEGATE); break;
         default:
             return; // unreachable
@@ -241,7 +582,7 @@ hdb_parse_rule_t rules[] = {
         [TOKEN_PERIOD]                              = {NULL, NULL, PREC_NONE},
         [TOKEN_BACKSLASH]                           = {NULL, NULL, PREC_NONE},
         [TOKEN_FORWARD_SLASH]                       = {NULL, binary, PREC_FACTOR},
-        [TOKEN_COLON]                               = {NULL, NULL, PREC_NONE},
+        [TOKEN_COLON]                               = { named_parameter, NULL, PREC_NONE},
         [TOKEN_SEMICOLON]                           = {NULL, NULL, PREC_NONE},
         [TOKEN_LESS_THAN]                           = {NULL, binary, PREC_COMPARISON},
         [TOKEN_EQUALS]                              = {NULL, binary, PREC_EQUALITY},
@@ -249,7 +590,7 @@ hdb_parse_rule_t rules[] = {
         [TOKEN_LESS_EQUAL]                          = {NULL, binary, PREC_COMPARISON},
         [TOKEN_GREATER_EQUAL]                       = {NULL, binary, PREC_COMPARISON},
         [TOKEN_GREATER_THAN]                        = {NULL, binary, PREC_COMPARISON},
-        [TOKEN_QUESTION_MARK]                       = {NULL, NULL, PREC_NONE},
+        [TOKEN_QUESTION_MARK]                       = { parameter, NULL, PREC_NONE},
         [TOKEN_LEFT_BRACKET]                        = {NULL, NULL, PREC_NONE},
         [TOKEN_RIGHT_BRACKET]                       = {NULL, NULL, PREC_NONE},
         [TOKEN_CIRCUMFLEX]                          = {NULL, NULL, PREC_NONE},
@@ -260,6 +601,7 @@ hdb_parse_rule_t rules[] = {
         [TOKEN_IDENTIFIER]                          = {NULL, NULL, PREC_NONE},
         [TOKEN_ENCLOSED_IDENTIFIER]                 = {NULL, NULL, PREC_NONE},
         [TOKEN_NUMBER]                              = { number, NULL, PREC_NONE},
+        [TOKEN_INTEGER_LITERAL]                     = { integer, NULL, PREC_NONE},
         [TOKEN_ERROR]                               = {NULL, NULL, PREC_NONE},
         [TOKEN_EOF]                                 = {NULL, NULL, PREC_NONE},
         [TOKEN_ABSOLUTE]                            = {NULL, NULL, PREC_NONE},
@@ -567,11 +909,13 @@ static void parse_precedence(hdb_precedence_t precedence) {
         return;
     }
 
+    const hdb_operand_start_t start = operand_start();
     prefix_rule();
 
     while(precedence <= get_rule(parser.current.type)->precedence) {
         advance();
         hdb_parse_fn infix_rule = get_rule(parser.previous.type)->infix;
+        left_operand = start;
         infix_rule();
     }
 }
@@ -587,6 +931,7 @@ static void expression(void) {
 bool hdb_compiler_compile(const char* source, hdb_chunk_t* chunk) {
     parser.had_error = parser.panic_mode = false;
     stack_high_water_mark = stack_size = 0;
+    last_instruction = 0;
 
     hdb_scanner_init(source);
     compiling_chunk = chunk;
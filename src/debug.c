@@ -1,10 +1,13 @@
+#include <inttypes.h> // PRId64
 #include <stdio.h>
 
 #include "debug.h"
+#include "memory.h"
 #include "value.h"
 #include "line.h"
 #include "object.h"
 #include "ustring.h"
+#include "vm.h"
 
 static int constant_instruction(const char* name, hdb_chunk_t* chunk, int32_t offset) {
     uint8_t index = chunk->code[offset + 1];
@@ -16,13 +19,7 @@ static int constant_instruction(const char* name, hdb_chunk_t* chunk, int32_t of
 }
 
 static int constant_long_instruction(const char* name, hdb_chunk_t* chunk, int32_t offset) {
-    uint8_t array[4] = {
-            chunk->code[offset + 3],
-            chunk->code[offset + 2],
-            chunk->code[offset + 1],
-            0
-    };
-    int32_t index = *(int32_t*)array;
+    int32_t index = HDB_CONSTANT_LONG_INDEX(chunk->code + offset + 1);
     printf("%-16s %4d '", name, index);
     hdb_dbg_print_value(chunk->constants.values[index]);
     printf("'\n");
@@ -35,6 +32,11 @@ static int simple_instruction(const char* name, int32_t offset) {
     return offset + 1;
 }
 
+static int byte_instruction(const char* name, hdb_chunk_t* chunk, int32_t offset) {
+    printf("%-16s %4d\n", name, chunk->code[offset + 1]);
+    return offset + 2;
+}
+
 static void print_object(hdb_value_t value) {
     switch (OBJ_TYPE(value)) {
         case OBJ_STRING:
@@ -104,6 +106,36 @@ int hdb_dbg_disassemble_instruction(hdb_chunk_t* chunk, int32_t offset) {
             return simple_instruction("OP_NOT", offset);
         case OP_NEGATE:
             return simple_instruction("OP_NEGATE", offset);
+        case OP_ADD_CONSTANT:
+            return constant_instruction("OP_ADD_CONSTANT", chunk, offset);
+        case OP_SUBTRACT_CONSTANT:
+            return constant_instruction("OP_SUBTRACT_CONSTANT", chunk, offset);
+        case OP_MULTIPLY_CONSTANT:
+            return constant_instruction("OP_MULTIPLY_CONSTANT", chunk, offset);
+        case OP_DIVIDE_CONSTANT:
+            return constant_instruction("OP_DIVIDE_CONSTANT", chunk, offset);
+        case OP_EQUAL_CONSTANT:
+            return constant_instruction("OP_EQUAL_CONSTANT", chunk, offset);
+        case OP_NOT_EQUAL_CONSTANT:
+            return constant_instruction("OP_NOT_EQUAL_CONSTANT", chunk, offset);
+        case OP_GREATER_CONSTANT:
+            return constant_instruction("OP_GREATER_CONSTANT", chunk, offset);
+        case OP_GREATER_EQUAL_CONSTANT:
+            return constant_instruction("OP_GREATER_EQUAL_CONSTANT", chunk, offset);
+        case OP_LESS_CONSTANT:
+            return constant_instruction("OP_LESS_CONSTANT", chunk, offset);
+        case OP_LESS_EQUAL_CONSTANT:
+            return constant_instruction("OP_LESS_EQUAL_CONSTANT", chunk, offset);
+        case OP_NOT_GREATER:
+            return simple_instruction("OP_NOT_GREATER", offset);
+        case OP_NOT_GREATER_EQUAL:
+            return simple_instruction("OP_NOT_GREATER_EQUAL", offset);
+        case OP_NOT_LESS:
+            return simple_instruction("OP_NOT_LESS", offset);
+        case OP_NOT_LESS_EQUAL:
+            return simple_instruction("OP_NOT_LESS_EQUAL", offset);
+        case OP_PARAMETER:
+            return byte_instruction("OP_PARAMETER", chunk, offset);
         case OP_RETURN:
             return simple_instruction("OP_RETURN", offset);
         default:
@@ -112,12 +144,65 @@ int hdb_dbg_disassemble_instruction(hdb_chunk_t* chunk, int32_t offset) {
     }
 }
 
+int32_t hdb_dbg_instruction_count(hdb_chunk_t* chunk) {
+    int32_t count = 0;
+    for (int32_t offset = 0; offset < chunk->count; offset += hdb_chunk_instruction_length(chunk, offset)) {
+        count++;
+    }
+
+    return count;
+}
+
+void hdb_dbg_print_instruction_counts(hdb_chunk_t* chunk, int32_t unoptimized_count) {
+    printf("== %d instructions, %d before optimizing ==\n", hdb_dbg_instruction_count(chunk), unoptimized_count);
+}
+
 void hdb_dbg_print_value(hdb_value_t value) {
-    switch (value.type) {
-        case VAL_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false"); break;
-        case VAL_NULL: printf("null"); break;
-        case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
-        case VAL_OBJ: print_object(value); break;
+    if (IS_BOOL(value)) {
+        printf(AS_BOOL(value) ? "true" : "false");
+    } else if (IS_NULL(value)) {
+        printf("null");
+    } else if (IS_NUMBER(value)) {
+        printf("%g", AS_NUMBER(value));
+    } else if (IS_INT(value)) {
+        printf("%" PRId64, AS_INT(value));
+    } else if (IS_OBJ(value)) {
+        print_object(value);
     }
 }
+
+void hdb_dbg_print_heap_stats(void) {
+    hdb_heap_stats_t stats;
+    if (!hdb_heap_stats(&stats)) {
+        printf("heap not initialized\n");
+        return;
+    }
+
+    printf("size          %zu\n", stats.current_size);
+    printf("free          %zu\n", stats.current_free);
+    printf("largest free  %zu\n", stats.largest_free);
+    printf("fragmentation %.4f\n", stats.fragmentation);
+    printf("peak used     %zu\n", stats.peak_used);
+    printf("grow events   %lu\n", (unsigned long)stats.grow_events);
+
+    printf("allocations per block size:\n");
+    for (int32_t class = 0; class < HDB_HEAP_SIZE_CLASSES; class++) {
+        if (stats.allocations[class]) {
+            printf("  %20zu %lu\n", (size_t)1 << class, (unsigned long)stats.allocations[class]);
+        }
+    }
+}
+
+void hdb_dbg_print_statement_cache_stats(void) {
+    const hdb_vm_t* vm = hdb_vm();
+    if (!vm) {
+        printf("vm not initialized\n");
+        return;
+    }
+
+    const hdb_statement_cache_t* cache = &vm->statement_cache;
+    printf("statements    %d of %d\n", cache->count, cache->capacity);
+    printf("hits          %lu\n", (unsigned long)cache->hits);
+    printf("misses        %lu\n", (unsigned long)cache->misses);
+    printf("evictions     %lu\n", (unsigned long)cache->evictions);
+}
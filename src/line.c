@@ -7,16 +7,27 @@ void hdb_line_array_init(hdb_line_array_t* array) {
     array->count = 0;
     array->capacity = 0;
     array->lines = NULL;
+    array->arena = NULL;
 }
 
 void hdb_line_array_free(hdb_line_array_t* array) {
-    HDB_FREE_ARRAY(hdb_line_t, array->lines);
+    hdb_arena_t* arena = array->arena;
+
+    HDB_ARENA_FREE_ARRAY(arena, hdb_line_t, array->lines);
     hdb_line_array_init(array);
+    array->arena = arena;
 }
 
-static void grow(hdb_line_array_t* lines) {
-    lines->capacity = HDB_GROW_CAPACITY(lines->capacity);
-    lines->lines = HDB_GROW_ARRAY(hdb_line_t, lines->lines, lines->capacity);
+static bool grow(hdb_line_array_t* lines) {
+    const int32_t capacity = HDB_GROW_CAPACITY(lines->capacity);
+    hdb_line_t* grown = HDB_ARENA_GROW_ARRAY(lines->arena, hdb_line_t, lines->lines, lines->capacity, capacity);
+    if (!grown) {
+        return false;
+    }
+
+    lines->lines = grown;
+    lines->capacity = capacity;
+    return true;
 }
 
 static int compare_lines(const void* left, const void* right) {
@@ -37,8 +48,8 @@ static hdb_line_t create_line(int32_t line) {
 }
 
 int32_t hdb_line_encode(hdb_line_array_t* array, int32_t line) {
-    if (array->count == 0 || array->capacity < array->count + 1) {
-        grow(array);
+    if ((array->count == 0 || array->capacity < array->count + 1) && !grow(array)) {
+        return -1;
     }
 
     if (array->count == 0) {
@@ -92,4 +103,20 @@ int32_t hdb_line_decode(hdb_line_array_t* array, int32_t instruction_index) {
     }
 
     return -1;
-}
\ No newline at end of file
+}
+
+void hdb_line_truncate(hdb_line_array_t* array, int32_t instruction_count) {
+    int32_t remaining = instruction_count < 0 ? 0 : instruction_count;
+
+    for (int32_t i = 0; i < array->count; i++) {
+        hdb_line_t* l = &array->lines[i];
+
+        if (remaining <= l->instruction_count) {
+            l->instruction_count = remaining;
+            array->count = remaining == 0 ? i : i + 1;
+            return;
+        }
+
+        remaining -= l->instruction_count;
+    }
+}
@@ -1,6 +1,7 @@
 #include <errno.h>
-#include <unistd.h> // for sbrk()
+#include <stdio.h> // for FILE
 #include <string.h> // for memcpy()
+#include <time.h> // for clock_gettime()
 
 #ifdef __APPLE__
 #include <sys/types.h>
@@ -14,16 +15,85 @@
 
 hdb_heap_t* heap;
 
+// The block cache of the current thread, if it is attached to the heap.
+static _Thread_local hdb_heap_cache_t* thread_cache;
+
+// Whether the current thread is running the memory pressure handlers.
+static _Thread_local bool relieving_pressure;
+
+// The allocation trace being recorded, if any. Records are buffered under the heap lock.
+static FILE* trace_file;
+static struct timespec trace_start;
+static hdb_heap_trace_record_t trace_buffer[HDB_HEAP_TRACE_BUFFER_SIZE];
+static size_t trace_count;
+
+/*
+ * Returns the size class of the given block size, which is the index of its most significant bit.
+ */
+static uint8_t size_class(size_t size) {
+    return (uint8_t)(63 - __builtin_clzll((unsigned long long)size));
+}
+
+/*
+ * Returns the lowest size class of which every block is guaranteed to be at least size bytes.
+ */
+static uint8_t size_class_ceil(size_t size) {
+    const uint8_t class = size_class(size);
+
+    return (size & (size - 1)) ? class + 1 : class;
+}
+
+/*
+ * Returns the block physically following the given block.
+ */
+static hdb_memory_block_t* next_block(hdb_memory_block_t* block) {
+    return (hdb_memory_block_t*)((char*)block + HDB_BLOCK_SIZE(block));
+}
+
+/*
+ * Returns the block physically preceding the given block, using the boundary tag of that block.
+ * This is only valid if the given block has the HDB_BLOCK_PREV_FREE flag set.
+ */
+static hdb_memory_block_t* prev_block(hdb_memory_block_t* block) {
+    const size_t prev_size = *((size_t*)block - 1);
+
+    return (hdb_memory_block_t*)((char*)block - prev_size);
+}
+
+/*
+ * Initializes a fence block at the given location, which marks the end of an arena.
+ */
+static void fence_init(hdb_memory_block_t* fence) {
+    fence->size = 0;
+    fence->next = NULL;
+    fence->prev = NULL;
+}
+
+/*
+ * Returns the arena which ends with the given fence block.
+ */
+static hdb_heap_arena_t* fence_arena(hdb_memory_block_t* fence) {
+    return (hdb_heap_arena_t*)((char*)fence + HDB_HEAP_PAGE_SIZE);
+}
+
+/*
+ * Returns the first block of the given arena, which is also the start of its mapping.
+ */
+static hdb_memory_block_t* arena_first_block(hdb_heap_arena_t* arena) {
+    return (hdb_memory_block_t*)((char*)arena - HDB_HEAP_PAGE_SIZE - arena->size);
+}
+
 static void free_list_remove(hdb_memory_block_t* block) {
     if (!heap || !block) {
         return;
     }
 
+    const size_t size = HDB_BLOCK_SIZE(block);
+    const uint8_t class = size_class(size);
     if (!block->prev) {
-        if (block->next) {
-            heap->free_blocks = block->next;
-        } else {
-            heap->free_blocks = NULL;
+        heap->free_lists[class] = block->next;
+        if (!block->next) {
+            heap->free_classes &= ~((uint64_t)1 << class);
         }
     } else {
         block->prev->next = block->next;
@@ -32,7 +102,9 @@ static void free_list_remove(hdb_memory_block_t* block) {
         block->next->prev = block->prev;
     }
 
-    heap->current_free -= block->size;
+    block->size &= ~(size_t)HDB_BLOCK_FREE;
+    __atomic_and_fetch(&next_block(block)->size, ~(size_t)HDB_BLOCK_PREV_FREE, __ATOMIC_RELAXED);
+    heap->current_free -= size;
 }
 
 static void free_list_add(hdb_memory_block_t* block) {
@@ -40,26 +112,32 @@ static void free_list_add(hdb_memory_block_t* block) {
         return;
     }
 
+    // Blocks are pushed in front of their size class list, which keeps both adding and removing O(1).
+    const size_t size = HDB_BLOCK_SIZE(block);
+    const uint8_t class = size_class(size);
     block->prev = NULL;
-    block->next = NULL;
-    if (!heap->free_blocks || heap->free_blocks > block) {
-        if (heap->free_blocks) {
-            heap->free_blocks->prev = block;
-        }
-        block->next = heap->free_blocks;
-        heap->free_blocks = block;
-    } else {
-        hdb_memory_block_t* current = heap->free_blocks;
-        while (current->next && current->next < block) {
-            current = current->next;
-        }
-
-        block->next = current->next;
-        block->prev = current;
-        current->next = block;
+    block->next = heap->free_lists[class];
+    if (block->next) {
+        block->next->prev = block;
     }
 
-    heap->current_free += block->size;
+    heap->free_lists[class] = block;
+    heap->free_classes |= (uint64_t)1 << class;
+    heap->current_free += size;
+
+    // Write the boundary tag and let the next block know it can merge with this one.
+    block->size |= HDB_BLOCK_FREE;
+    *(size_t*)((char*)block + size - sizeof(size_t)) = size;
+    __atomic_or_fetch(&next_block(block)->size, HDB_BLOCK_PREV_FREE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Returns the size of an allocated block without holding the heap lock. Only the thread that owns the block changes
+ * its size, but other threads flip its HDB_BLOCK_PREV_FREE flag under the lock when its predecessor is freed or
+ * taken, which is why free_list_add() and free_list_remove() update that flag atomically.
+ */
+static size_t owned_block_size(hdb_memory_block_t* block) {
+    return __atomic_load_n(&block->size, __ATOMIC_RELAXED) & ~(size_t)HDB_BLOCK_FLAGS;
 }
 
 /*
@@ -67,7 +145,8 @@ static void free_list_add(hdb_memory_block_t* block) {
  */
 static size_t align_pow2(size_t value) {
 #ifdef HDB_TESTING_NOALIGN
-    return value;
+    // Block sizes must still be a multiple of 8, since the lowest bits are used to store block flags.
+    return (value + 7) & ~(size_t)7;
 #else
 
     if (value && !(value & (value - 1))) {
@@ -80,7 +159,7 @@ static size_t align_pow2(size_t value) {
         count++;
     }
 
-    return 1 << count;
+    return (size_t)1 << count;
 #endif
 }
 
@@ -111,6 +190,142 @@ static size_t initial_heap_size(size_t requested) {
     return aligned_requested;
 }
 
+/*
+ * Returns the size of the pages backing the heap.
+ */
+static size_t heap_page_size(void) {
+    return heap->flags & HDB_HEAP_HUGE_PAGES ? HDB_HEAP_HUGE_PAGE_SIZE : os_page_size();
+}
+
+/*
+ * Reserves a new arena with room for size bytes of blocks, and adds its memory to the heap as a single free block.
+ */
+static hdb_heap_arena_t* arena_create(size_t size) {
+    const size_t page_size = os_page_size();
+    const size_t alignment = heap_page_size();
+    const size_t mapped_size = (size + HDB_HEAP_PAGE_SIZE + sizeof(hdb_heap_arena_t) + alignment - 1)
+            & ~(alignment - 1);
+
+    // Prefer explicit huge pages, which are committed right away. Fall back to transparent huge pages otherwise.
+    void* memory = NULL;
+    size_t committed = page_size;
+    if (heap->flags & HDB_HEAP_HUGE_PAGES) {
+        memory = os_map_huge(mapped_size);
+        if (memory) {
+            committed = mapped_size;
+        } else if ((memory = os_reserve_aligned(mapped_size, alignment))) {
+            os_advise_huge(memory, mapped_size);
+        }
+    } else {
+        memory = os_reserve(mapped_size);
+    }
+
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    // Commit the header of the first block, and the pages at the end holding its boundary tag, the fence and the
+    // arena header. Everything in between is committed on demand.
+    const size_t tail = ((size - sizeof(size_t)) & ~(page_size - 1));
+    if (committed < mapped_size
+            && (os_commit(memory, page_size) != 0 || os_commit((char*)memory + tail, mapped_size - tail) != 0)) {
+        os_unmap(memory, mapped_size);
+        return NULL;
+    }
+
+    hdb_memory_block_t* block = (hdb_memory_block_t*)memory;
+    block->next = NULL;
+    block->prev = NULL;
+    block->size = size;
+
+    hdb_memory_block_t* fence = next_block(block);
+    fence_init(fence);
+
+    hdb_heap_arena_t* arena = fence_arena(fence);
+    arena->size = size;
+    arena->mapped_size = mapped_size;
+    arena->committed = committed;
+    arena->prev = NULL;
+    arena->next = heap->arenas;
+    if (arena->next) {
+        arena->next->prev = arena;
+    }
+    heap->arenas = arena;
+
+    heap->current_size += size;
+    free_list_add(block);
+
+    return arena;
+}
+
+/*
+ * Makes sure the given arena is committed up to the given address. Memory is committed in steps of
+ * HDB_HEAP_COMMIT_SIZE, or of a huge page if larger, to keep the amount of system calls low.
+ * Returns false if committing fails.
+ */
+static bool arena_commit(hdb_heap_arena_t* arena, void* end) {
+    char* start = (char*)arena_first_block(arena);
+    const size_t required = (size_t)((char*)end - start);
+
+    if (required <= arena->committed) {
+        return true;
+    }
+
+    const size_t step = heap_page_size() > HDB_HEAP_COMMIT_SIZE ? heap_page_size() : HDB_HEAP_COMMIT_SIZE;
+    size_t committed = (required + step - 1) & ~(step - 1);
+    if (committed > arena->mapped_size) {
+        committed = arena->mapped_size;
+    }
+
+    if (os_commit(start + arena->committed, committed - arena->committed) != 0) {
+        return false;
+    }
+
+    arena->committed = committed;
+    return true;
+}
+
+/*
+ * Unmaps the given arena. Its blocks must not be on any free list anymore.
+ */
+static void arena_destroy(hdb_heap_arena_t* arena) {
+    if (arena->prev) {
+        arena->prev->next = arena->next;
+    } else {
+        heap->arenas = arena->next;
+    }
+    if (arena->next) {
+        arena->next->prev = arena->prev;
+    }
+
+    heap->current_size -= arena->size;
+    os_unmap(arena_first_block(arena), arena->mapped_size);
+}
+
+/*
+ * Returns the pages within [start, end) to the OS, if the given free block is large enough to justify the
+ * system call. The header and boundary tag of the free block are never released.
+ */
+static void release_pages(hdb_memory_block_t* block, void* start, void* end) {
+    if (HDB_BLOCK_SIZE(block) < HDB_HEAP_RETURN_BARRIER) {
+        return;
+    }
+
+    const size_t page_size = os_page_size();
+    uintptr_t first = (uintptr_t)start > (uintptr_t)block + HDB_HEAP_PAGE_SIZE
+            ? (uintptr_t)start
+            : (uintptr_t)block + HDB_HEAP_PAGE_SIZE;
+    uintptr_t last = (uintptr_t)end < (uintptr_t)block + HDB_BLOCK_SIZE(block) - sizeof(size_t)
+            ? (uintptr_t)end
+            : (uintptr_t)block + HDB_BLOCK_SIZE(block) - sizeof(size_t);
+
+    first = (first + page_size - 1) & ~(page_size - 1);
+    last &= ~(page_size - 1);
+    if (first < last) {
+        os_release((void*)first, last - first);
+    }
+}
+
 /*
  * Splits the given block by creating a new block after size bytes, and resizes the given block
  * accordingly. The newly created block is returned. This method assumes the given block contains enough space
@@ -141,28 +356,82 @@ static size_t initial_heap_size(size_t requested) {
  */
 static hdb_memory_block_t* split(hdb_memory_block_t* block, size_t split_size) {
     // Create a new block starting at split_size
-    hdb_memory_block_t* split = (hdb_memory_block_t*)(block + (block->size - split_size));
+    hdb_memory_block_t* split = (hdb_memory_block_t*)((char*)block + (HDB_BLOCK_SIZE(block) - split_size));
 
     // Initialize the new block. Get size by subtracting required size from block size.
     split->size = split_size;
     split->next = NULL;
     split->prev = NULL;
 
-    block->size -= split->size;
+    // The flags of block are kept intact, since split_size is always a multiple of 8.
+    block->size -= split_size;
 
     return split;
 }
 
-static void merge_if_continuous(hdb_memory_block_t* left, hdb_memory_block_t* right) {
-    if (left + left->size == right) { // merge only continuous memory regions
-        left->size += right->size;
-        left->next = right->next;
+/*
+ * Splits off the bytes of the given block beyond block_size and returns them to the heap, if they are enough to
+ * hold another block. The split off bytes are merged with the following block if that is free.
+ * The given block must not be on a free list.
+ */
+static void trim(hdb_memory_block_t* block, size_t block_size) {
 
-        merge_if_continuous(left, left->next); // recursion
+    // To avoid cases where aligned_size < sizeof(hdb_memory_block_t).
+    const size_t min_splittable_size = block_size + align_pow2(HDB_HEAP_PAGE_SIZE * 2);
+
+    if (HDB_BLOCK_SIZE(block) >= min_splittable_size) {
+
+        // Split off extraneous bytes.
+        hdb_memory_block_t* tail = split(block, HDB_BLOCK_SIZE(block) - block_size);
+        hdb_memory_block_t* next = next_block(tail);
+        if (next->size & HDB_BLOCK_FREE) {
+            free_list_remove(next);
+            tail->size += HDB_BLOCK_SIZE(next);
+        }
+
+        free_list_add(tail);
+    }
+
+    // Otherwise the block is larger than what we need, but cannot split, because another hdb_memory_block_t and
+    // at least one byte user memory don't fit in the extraneous bytes.
+    // This keeps the extraneous amount of bytes to a minimum.
+}
+
+/*
+ * Splits the given block so the memory of the returned block is aligned to alignment bytes. The bytes in front of
+ * the returned block are handed back to the heap as a free block, so there are either none of them, or enough to
+ * hold the header and boundary tag of a free block. The given block must not be on a free list, and must have room
+ * for the aligned block behind at most alignment + HDB_HEAP_ALIGNED_PADDING bytes.
+ */
+static hdb_memory_block_t* split_aligned(hdb_memory_block_t* block, size_t alignment) {
+    const uintptr_t memory = (uintptr_t)HDB_MEMORY_PTR(block);
+    uintptr_t aligned = (memory + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if (aligned == memory) {
+        return block;
+    }
+
+    while (aligned - memory < HDB_HEAP_ALIGNED_PADDING) {
+        aligned += alignment;
     }
+
+    const size_t prefix_size = (size_t)(aligned - memory);
+    hdb_memory_block_t* aligned_block = (hdb_memory_block_t*)((char*)block + prefix_size);
+    aligned_block->size = HDB_BLOCK_SIZE(block) - prefix_size;
+    aligned_block->next = NULL;
+    aligned_block->prev = NULL;
+
+    // The front of the block keeps its flags, and lets the aligned block know it is free.
+    block->size = prefix_size | (block->size & HDB_BLOCK_FLAGS);
+    free_list_add(block);
+
+    return aligned_block;
 }
 
 hdb_heap_view_t* hdb_heap_init(size_t min_size, size_t max_size) {
+    return hdb_heap_init_flags(min_size, max_size, HDB_HEAP_DEFAULT);
+}
+
+hdb_heap_view_t* hdb_heap_init_flags(size_t min_size, size_t max_size, uint32_t flags) {
     if (max_size < min_size || min_size == 0) {
         errno = EINVAL;
         return NULL;
@@ -175,7 +444,15 @@ hdb_heap_view_t* hdb_heap_init(size_t min_size, size_t max_size) {
             .max_size = actual_max_size,
             .current_size = 0,
             .current_free = 0,
-            .free_blocks = NULL
+            .free_classes = 0,
+            .free_lists = {NULL},
+            .arenas = NULL,
+            .flags = flags,
+            .allocations = {0},
+            .peak_used = 0,
+            .grow_events = 0,
+            .pressure_handlers = {{NULL}},
+            .pressure_handler_count = 0
     };
 
     heap = (hdb_heap_t *)os_malloc(sizeof(hdb_heap_t));
@@ -183,23 +460,15 @@ hdb_heap_view_t* hdb_heap_init(size_t min_size, size_t max_size) {
         return NULL;
     }
     memcpy(heap, &init, sizeof(hdb_heap_t));
+    pthread_mutex_init(&heap->lock, NULL);
 
-    void* memory = os_malloc(heap->min_size);
-    if (memory == NULL) {
+    if (arena_create(heap->min_size) == NULL) {
+        pthread_mutex_destroy(&heap->lock);
+        os_free(heap);
+        heap = NULL;
         return NULL;
     }
 
-    // Initialize heap memory
-    hdb_memory_block_t* block = (hdb_memory_block_t*)memory;
-    block->next = NULL;
-    block->prev = NULL;
-    block->size = heap->min_size;
-
-    heap->current_size = heap->min_size;
-    heap->current_free = heap->min_size;
-    heap->free_blocks = block;
-    heap->free_ptr = block;
-
     return (hdb_heap_view_t*)heap;
 }
 
@@ -207,117 +476,578 @@ hdb_heap_view_t* hdb_heap(void) {
     return (hdb_heap_view_t*)heap;
 }
 
-void hdb_heap_compact() {
-    hdb_memory_block_t* current_block = heap->free_blocks;
-    while (current_block) {
-        hdb_memory_block_t* next_block = current_block->next;
+bool hdb_heap_stats(hdb_heap_stats_t* stats) {
+    if (!heap) {
+        return false;
+    }
 
-        if (next_block) {
-            merge_if_continuous(current_block, next_block);
-            current_block = current_block->next;
-        } else {
-            current_block = next_block;
+    pthread_mutex_lock(&heap->lock);
+    stats->current_size = heap->current_size;
+    stats->current_free = heap->current_free;
+    stats->peak_used = heap->peak_used;
+    stats->grow_events = heap->grow_events;
+    memcpy(stats->allocations, heap->allocations, sizeof(stats->allocations));
+
+    // The largest free block is in the highest non-empty size class, which is the only list that must be walked.
+    stats->largest_free = 0;
+    if (heap->free_classes) {
+        hdb_memory_block_t* block = heap->free_lists[63 - __builtin_clzll(heap->free_classes)];
+        for (; block; block = block->next) {
+            if (HDB_BLOCK_SIZE(block) > stats->largest_free) {
+                stats->largest_free = HDB_BLOCK_SIZE(block);
+            }
         }
     }
+    pthread_mutex_unlock(&heap->lock);
+
+    stats->fragmentation = stats->current_free
+            ? 1.0 - (double)stats->largest_free / (double)stats->current_free
+            : 0.0;
+
+    return true;
 }
 
 void hdb_heap_free() {
     if (heap) {
-        os_free(heap->free_ptr);
+        hdb_heap_trace_stop();
+
+        while (heap->arenas) {
+            arena_destroy(heap->arenas);
+        }
+        pthread_mutex_destroy(&heap->lock);
         os_free(heap);
         heap = NULL;
     }
 }
 
-void* hdb_malloc(size_t size) {
-    if (!heap || size == 0) {
-        return NULL;
+/*
+ * Makes sure the first block_size bytes of the given free block are committed, including the header of the block
+ * which trim() may split off behind them. Only the last block of an arena can contain uncommitted memory.
+ */
+static bool block_commit(hdb_memory_block_t* block, size_t block_size) {
+    hdb_memory_block_t* next = next_block(block);
+    if (HDB_BLOCK_SIZE(next) != 0) {
+        return true;
     }
 
-    const size_t block_size = align_pow2(size + HDB_HEAP_PAGE_SIZE);
-
-    // To avoid cases where aligned_size < sizeof(hdb_memory_block_t).
+    // If trim() cannot split the block, it is handed out as a whole and must be committed entirely.
     const size_t min_splittable_size = block_size + align_pow2(HDB_HEAP_PAGE_SIZE * 2);
+    const size_t commit_size = HDB_BLOCK_SIZE(block) < min_splittable_size
+            ? HDB_BLOCK_SIZE(block)
+            : block_size + HDB_HEAP_PAGE_SIZE;
 
-    void* mem_pointer;
-    hdb_memory_block_t *ptr;
-    ptr = heap->free_blocks;
+    return arena_commit(fence_arena(next), (char*)block + commit_size);
+}
 
-    while (ptr) {
-        if (ptr->size >= block_size) {
-            free_list_remove(ptr);
-            mem_pointer = HDB_MEMORY_PTR(ptr);
+/*
+ * Removes the given free block of at least block_size bytes from the free lists, and trims it to block_size.
+ * Returns NULL if the block cannot be committed. The caller must hold the heap lock.
+ */
+static hdb_memory_block_t* block_claim(hdb_memory_block_t* block, size_t block_size) {
+    if (!block_commit(block, block_size)) {
+        return NULL;
+    }
 
-            if (ptr->size >= min_splittable_size) {
+    free_list_remove(block);
+    trim(block, block_size);
 
-                // Split off extraneous bytes.
-                free_list_add(split(ptr, ptr->size - block_size));
-            }
+    const size_t used = heap->current_size - heap->current_free;
+    if (used > heap->peak_used) {
+        heap->peak_used = used;
+    }
 
-            // Block is larger than what we need, but cannot split, because another hdb_memory_block_t and
-            // at least one byte user memory don't fit in the extraneous bytes.
-            // This keeps the extraneous amount of bytes to a minimum.
-            return mem_pointer;
-        }
+    return block;
+}
+
+/*
+ * Takes a block of exactly block_size bytes from the free lists, growing the heap if required.
+ * Returns NULL if no such block is available. The caller must hold the heap lock.
+ */
+static hdb_memory_block_t* block_take(size_t block_size) {
+
+    // Every block in the size class of block_size or any class above it is large enough, so the first
+    // non-empty class in that range yields a suitable block without walking any list.
+    const uint8_t min_class = size_class_ceil(block_size);
+    const uint64_t candidates = min_class < HDB_HEAP_SIZE_CLASSES
+            ? heap->free_classes & (~(uint64_t)0 << min_class)
+            : 0;
 
-        ptr = ptr->next;
+    if (candidates) {
+        return block_claim(heap->free_lists[__builtin_ctzll(candidates)], block_size);
     }
 
-    // Try to grow heap, but never over configured limit.
+    // Try to grow heap with a new arena, but never over configured limit.
     if (heap->current_size < heap->max_size) {
-        size_t increase_size = HDB_HEAP_INCREASE_SIZE;
+        size_t increase_size = block_size > HDB_HEAP_INCREASE_SIZE ? block_size : HDB_HEAP_INCREASE_SIZE;
 
         // Never allocate over heap->max_size.
         if (heap->current_size + increase_size > heap->max_size) {
             increase_size = heap->max_size - heap->current_size;
         }
 
-        if (increase_size > 0) {
-            hdb_memory_block_t *new_block = (hdb_memory_block_t *) sbrk(increase_size);
-            if (new_block) {
-                new_block->next = NULL;
-                new_block->prev = NULL;
-                new_block->size = increase_size;
-                free_list_add(new_block);
+        // The new arena is a single free block of increase_size bytes. Claim it directly, since it can be in a lower
+        // size class than block_take() searches if block_size is not a power of two.
+        hdb_heap_arena_t* arena;
+        if (increase_size >= block_size && (arena = arena_create(increase_size))) {
+            heap->grow_events++;
+            return block_claim(arena_first_block(arena), block_size);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Returns the given allocated block to the free lists, merging it with its free neighbours. The caller must
+ * hold the heap lock.
+ */
+static void block_release(hdb_memory_block_t* block) {
+    void* freed_start = HDB_MEMORY_PTR(block);
+    void* freed_end = (char*)block + HDB_BLOCK_SIZE(block);
+
+    // Merge with the following block if it is free.
+    hdb_memory_block_t* next = next_block(block);
+    if (next->size & HDB_BLOCK_FREE) {
+        free_list_remove(next);
+        block->size += HDB_BLOCK_SIZE(next);
+    }
+
+    // Merge with the preceding block if it is free, using its boundary tag to find it.
+    if (block->size & HDB_BLOCK_PREV_FREE) {
+        hdb_memory_block_t* prev = prev_block(block);
+        free_list_remove(prev);
+        prev->size += HDB_BLOCK_SIZE(block);
+        block = prev;
+    }
+
+    // Unmap the arena if it became entirely free, unless that shrinks the heap below its minimum size or
+    // leaves too little free memory to serve the next allocations without mapping a new arena right away.
+    hdb_memory_block_t* next_to_merged = next_block(block);
+    if (HDB_BLOCK_SIZE(next_to_merged) == 0) {
+        hdb_heap_arena_t* arena = fence_arena(next_to_merged);
+
+        if (arena->size == HDB_BLOCK_SIZE(block)
+                && heap->current_size - arena->size >= heap->min_size
+                && heap->current_free >= HDB_HEAP_RETURN_BARRIER) {
+            arena_destroy(arena);
+            return;
+        }
+    }
+
+    release_pages(block, freed_start, freed_end);
+    free_list_add(block);
+}
+
+/*
+ * Adds the allocations served by the given bin of the thread cache to the heap statistics. The caller must hold
+ * the heap lock.
+ */
+static void cache_count(hdb_heap_cache_t* cache, uint8_t class) {
+    heap->allocations[class] += cache->allocations[class];
+    cache->allocations[class] = 0;
+}
+
+/*
+ * Moves up to count blocks from the given bin of the thread cache back to the heap, under a single lock.
+ */
+static void cache_flush(hdb_heap_cache_t* cache, uint8_t class, uint16_t count) {
+    pthread_mutex_lock(&heap->lock);
+    cache_count(cache, class);
+    while (count-- && cache->bins[class]) {
+        hdb_memory_block_t* block = cache->bins[class];
+        cache->bins[class] = block->next;
+        cache->counts[class]--;
+
+        block_release(block);
+    }
+    pthread_mutex_unlock(&heap->lock);
+}
+
+/*
+ * Refills the given bin of the thread cache. A single block large enough for a whole batch is taken from the heap
+ * and cut into blocks of the size class, so the heap lock is only taken once. The batch is cut while holding the
+ * lock, since other threads update the flags of the first block when they free or take the block preceding it.
+ */
+static void cache_refill(hdb_heap_cache_t* cache, uint8_t class) {
+    const size_t block_size = (size_t)1 << class;
+
+    pthread_mutex_lock(&heap->lock);
+    cache_count(cache, class);
+    hdb_memory_block_t* batch = block_take(block_size * HDB_HEAP_CACHE_BATCH);
+    if (!batch) {
+
+        // The heap is too fragmented or too close to its limit for a whole batch, so settle for a single block.
+        batch = block_take(block_size);
+    }
+
+    if (batch) {
+        while (HDB_BLOCK_SIZE(batch) >= block_size * 2) {
+            hdb_memory_block_t* block = split(batch, block_size);
+            block->next = cache->bins[class];
+            cache->bins[class] = block;
+            cache->counts[class]++;
+        }
+
+        batch->next = cache->bins[class];
+        cache->bins[class] = batch;
+        cache->counts[class]++;
+    }
+    pthread_mutex_unlock(&heap->lock);
+}
+
+hdb_heap_cache_t* hdb_heap_thread_attach(void) {
+    if (heap && !thread_cache) {
+        hdb_heap_cache_t init = {
+                .bins = {NULL},
+                .counts = {0},
+                .allocations = {0}
+        };
+
+        thread_cache = (hdb_heap_cache_t*)os_malloc(sizeof(hdb_heap_cache_t));
+        memcpy(thread_cache, &init, sizeof(hdb_heap_cache_t));
+    }
+
+    return thread_cache;
+}
+
+void hdb_heap_thread_detach(void) {
+    if (thread_cache) {
+        if (heap) {
+            for (uint8_t class = 0; class <= HDB_HEAP_CACHE_MAX_CLASS; class++) {
+                cache_flush(thread_cache, class, thread_cache->counts[class]);
             }
+        }
 
-            heap->current_size += increase_size;
-            return hdb_malloc(size); // recursion
+        os_free(thread_cache);
+        thread_cache = NULL;
+    }
+}
+
+hdb_heap_cache_t* hdb_heap_thread_cache(void) {
+    return thread_cache;
+}
+
+/*
+ * Writes the buffered trace records to the trace file. The caller must hold the heap lock.
+ */
+static void trace_flush(void) {
+    if (trace_count) {
+        fwrite(trace_buffer, sizeof(hdb_heap_trace_record_t), trace_count, trace_file);
+        trace_count = 0;
+    }
+}
+
+/*
+ * Adds a record of the given operation to the trace, if one is being recorded.
+ */
+static void trace_record(uint8_t operation, void* address, void* previous, size_t size) {
+    if (!__atomic_load_n(&trace_file, __ATOMIC_ACQUIRE) || !heap) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&heap->lock);
+    if (trace_file) {
+        if (trace_count == HDB_HEAP_TRACE_BUFFER_SIZE) {
+            trace_flush();
         }
+
+        hdb_heap_trace_record_t* record = &trace_buffer[trace_count++];
+        memset(record, 0, sizeof(hdb_heap_trace_record_t));
+        record->timestamp = (uint64_t)(now.tv_sec - trace_start.tv_sec) * 1000000000
+                + (uint64_t)now.tv_nsec - (uint64_t)trace_start.tv_nsec;
+        record->address = (uint64_t)(uintptr_t)address;
+        record->previous = (uint64_t)(uintptr_t)previous;
+        record->size = size;
+        record->operation = operation;
     }
+    pthread_mutex_unlock(&heap->lock);
+}
 
-    os_abort();
+bool hdb_heap_trace_start(const char* path) {
+    if (!heap) {
+        errno = EINVAL;
+        return false;
+    }
+
+    hdb_heap_trace_stop();
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    pthread_mutex_lock(&heap->lock);
+    clock_gettime(CLOCK_MONOTONIC, &trace_start);
+    trace_count = 0;
+    __atomic_store_n(&trace_file, file, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&heap->lock);
+
+    return true;
 }
 
-void hdb_free(void* ptr) {
+void hdb_heap_trace_stop(void) {
+    if (heap && trace_file) {
+        pthread_mutex_lock(&heap->lock);
+        trace_flush();
+        fclose(trace_file);
+        __atomic_store_n(&trace_file, NULL, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&heap->lock);
+    }
+}
+
+bool hdb_heap_pressure_register(hdb_heap_pressure_handler_t handler, void* context, int32_t priority) {
+    if (!heap || !handler) {
+        errno = EINVAL;
+        return false;
+    }
+
+    pthread_mutex_lock(&heap->lock);
+    if (heap->pressure_handler_count == HDB_HEAP_PRESSURE_HANDLERS) {
+        pthread_mutex_unlock(&heap->lock);
+        errno = ENOMEM;
+        return false;
+    }
+
+    // Insert behind all handlers with the same or a lower priority.
+    int32_t index = heap->pressure_handler_count;
+    while (index > 0 && heap->pressure_handlers[index - 1].priority > priority) {
+        heap->pressure_handlers[index] = heap->pressure_handlers[index - 1];
+        index--;
+    }
+
+    heap->pressure_handlers[index].handler = handler;
+    heap->pressure_handlers[index].context = context;
+    heap->pressure_handlers[index].priority = priority;
+    heap->pressure_handler_count++;
+    pthread_mutex_unlock(&heap->lock);
+
+    return true;
+}
+
+void hdb_heap_pressure_unregister(hdb_heap_pressure_handler_t handler, void* context) {
+    if (!heap) {
+        return;
+    }
+
+    pthread_mutex_lock(&heap->lock);
+    for (int32_t index = 0; index < heap->pressure_handler_count; index++) {
+        hdb_heap_pressure_entry_t* entry = &heap->pressure_handlers[index];
+
+        if (entry->handler == handler && entry->context == context) {
+            memmove(entry, entry + 1, sizeof(hdb_heap_pressure_entry_t) * (heap->pressure_handler_count - index - 1));
+            heap->pressure_handler_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&heap->lock);
+}
+
+/*
+ * Takes a block of exactly block_size bytes from the heap like block_take() and counts the allocation, but relieves
+ * memory pressure before giving up. First the cache of the calling thread is flushed, then the pressure handlers run
+ * in priority order.
+ */
+static hdb_memory_block_t* block_take_under_pressure(size_t size, size_t block_size) {
+    pthread_mutex_lock(&heap->lock);
+    hdb_memory_block_t* block = block_take(block_size);
+    if (block) {
+        heap->allocations[size_class(HDB_BLOCK_SIZE(block))]++;
+    }
+    pthread_mutex_unlock(&heap->lock);
+
+    if (block || relieving_pressure) {
+        return block;
+    }
+
+    relieving_pressure = true;
+    if (thread_cache) {
+        for (uint8_t class = 0; class <= HDB_HEAP_CACHE_MAX_CLASS; class++) {
+            cache_flush(thread_cache, class, thread_cache->counts[class]);
+        }
+    }
+
+    // The handlers run without holding the heap lock, since they return memory to the heap themselves.
+    bool retry = true;
+    for (int32_t index = 0; ; index++) {
+        pthread_mutex_lock(&heap->lock);
+        block = retry ? block_take(block_size) : NULL;
+
+        hdb_heap_pressure_entry_t entry = {NULL};
+        if (block) {
+            heap->allocations[size_class(HDB_BLOCK_SIZE(block))]++;
+        } else if (index < heap->pressure_handler_count) {
+            entry = heap->pressure_handlers[index];
+        }
+        pthread_mutex_unlock(&heap->lock);
+
+        if (block || !entry.handler) {
+            break;
+        }
+
+        retry = entry.handler(size, entry.context);
+    }
+    relieving_pressure = false;
+
+    return block;
+}
+
+static void* heap_malloc(size_t size) {
+    if (!heap || size == 0) {
+        return NULL;
+    }
+
+    const size_t block_size = align_pow2(size + HDB_HEAP_PAGE_SIZE);
+    const uint8_t class = size_class(block_size);
+
+    // Attached threads serve small blocks from their cache, which only needs the heap lock to refill it.
+    hdb_heap_cache_t* cache = thread_cache;
+    if (cache && class <= HDB_HEAP_CACHE_MAX_CLASS && !(block_size & (block_size - 1))) {
+        if (!cache->bins[class]) {
+            cache_refill(cache, class);
+        }
+
+        hdb_memory_block_t* block = cache->bins[class];
+        if (block) {
+            cache->bins[class] = block->next;
+            cache->counts[class]--;
+            cache->allocations[class]++;
+
+            return HDB_MEMORY_PTR(block);
+        }
+    }
+
+    hdb_memory_block_t* block = block_take_under_pressure(size, block_size);
+    if (!block) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return HDB_MEMORY_PTR(block);
+}
+
+static void* heap_malloc_aligned(size_t size, size_t alignment) {
+    if (alignment & (alignment - 1)) {
+        errno = EINVAL;
+        return NULL;
+    } else if (alignment <= sizeof(size_t)) {
+        return heap_malloc(size);
+    } else if (!heap || size == 0) {
+        return NULL;
+    }
+
+    // Take a block with enough room to move its start to the first aligned address, and give back what is left.
+    const size_t block_size = (size + HDB_HEAP_PAGE_SIZE + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+    hdb_memory_block_t* block = block_take_under_pressure(size, block_size + alignment + HDB_HEAP_ALIGNED_PADDING);
+    if (!block) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&heap->lock);
+    block = split_aligned(block, alignment);
+    trim(block, block_size);
+    pthread_mutex_unlock(&heap->lock);
+
+    return HDB_MEMORY_PTR(block);
+}
+
+static void heap_free(void* ptr) {
     if (heap && ptr) {
         hdb_memory_block_t* block = HDB_BLOCK_PTR(ptr);
+        const size_t block_size = owned_block_size(block);
+        const uint8_t class = size_class(block_size);
+
+        // Attached threads keep blocks of exactly a cached size class, and flush a batch to the heap when full.
+        hdb_heap_cache_t* cache = thread_cache;
+        if (cache && class <= HDB_HEAP_CACHE_MAX_CLASS && !(block_size & (block_size - 1))) {
+            if (cache->counts[class] >= HDB_HEAP_CACHE_CAPACITY) {
+                cache_flush(cache, class, HDB_HEAP_CACHE_BATCH);
+            }
 
-        free_list_add(block);
+            block->next = cache->bins[class];
+            cache->bins[class] = block;
+            cache->counts[class]++;
+            return;
+        }
+
+        pthread_mutex_lock(&heap->lock);
+        block_release(block);
+        pthread_mutex_unlock(&heap->lock);
     }
 }
 
-void* hdb_reallocate(void* ptr, size_t new_size) {
+static void* heap_reallocate(void* ptr, size_t new_size) {
     if (!heap) {
         return NULL;
     } else if (!ptr) {
-        return hdb_malloc(new_size);
+        return heap_malloc(new_size);
     }
 
     if (new_size == 0) {
-        hdb_free(ptr);
+        heap_free(ptr);
         return NULL;
     }
 
     hdb_memory_block_t* block = HDB_BLOCK_PTR(ptr);
-    if (block->size >= new_size) {
+    const size_t usable_size = owned_block_size(block) - HDB_HEAP_PAGE_SIZE;
+    if (usable_size >= new_size) {
+        return ptr;
+    }
+
+    // Try to grow in place by absorbing the physically next block, if it is free and large enough. The next block
+    // belongs to the heap or another thread, so its header is only read while holding the lock.
+    const size_t block_size = align_pow2(new_size + HDB_HEAP_PAGE_SIZE);
+    pthread_mutex_lock(&heap->lock);
+    hdb_memory_block_t* next = next_block(block);
+    if ((next->size & HDB_BLOCK_FREE) && HDB_BLOCK_SIZE(block) + HDB_BLOCK_SIZE(next) >= block_size
+            && block_commit(next, block_size - HDB_BLOCK_SIZE(block))) {
+        free_list_remove(next);
+        block->size += HDB_BLOCK_SIZE(next);
+        trim(block, block_size);
+
+        pthread_mutex_unlock(&heap->lock);
         return ptr;
     }
+    pthread_mutex_unlock(&heap->lock);
 
-    void* new_block = hdb_malloc(new_size);
+    // Otherwise move the data to a new block and release the old one.
+    void* new_block = heap_malloc(new_size);
     if (new_block) {
-        return memcpy(new_block, ptr, block->size);
+        memcpy(new_block, ptr, usable_size);
+        heap_free(ptr);
     }
 
-    return NULL;
-}
\ No newline at end of file
+    return new_block;
+}
+
+void* hdb_malloc(size_t size) {
+    void* ptr = heap_malloc(size);
+    trace_record(HDB_HEAP_TRACE_MALLOC, ptr, NULL, size);
+
+    return ptr;
+}
+
+void* hdb_malloc_aligned(size_t size, size_t alignment) {
+    void* ptr = heap_malloc_aligned(size, alignment);
+    trace_record(HDB_HEAP_TRACE_MALLOC, ptr, NULL, size);
+
+    return ptr;
+}
+
+void hdb_free(void* ptr) {
+    if (ptr) {
+        trace_record(HDB_HEAP_TRACE_FREE, ptr, NULL, 0);
+    }
+
+    heap_free(ptr);
+}
+
+void* hdb_reallocate(void* ptr, size_t new_size) {
+    void* new_ptr = heap_reallocate(ptr, new_size);
+    trace_record(HDB_HEAP_TRACE_REALLOCATE, new_ptr, ptr, new_size);
+
+    return new_ptr;
+}
@@ -1,7 +1,10 @@
 #include <string.h>
 
 #include "memory.h"
+#include "slab.h"
 #include "object.h"
+#include "os.h"
+#include "ustring.h"
 #include "vm.h"
 
 static void init_object(hdb_object_t* object, hdb_object_type_t type) {
@@ -9,11 +12,31 @@ static void init_object(hdb_object_t* object, hdb_object_type_t type) {
     hdb_vm_notify_new(object);
 }
 
+/*
+ * Returns the amount of bytes that were requested when the given object was created.
+ */
+static size_t object_size(hdb_object_t* object) {
+    switch (object->type) {
+        case OBJ_STRING:
+            return sizeof(hdb_ustring_t) + ((hdb_ustring_t*)object)->byte_length + 1;
+        default:
+            // Freeing the object with a made up size would corrupt the slab lists.
+            os_abort();
+            return 0;
+    }
+}
+
 hdb_object_t* hdb_object_create(size_t size, hdb_object_type_t type) {
-    hdb_object_t* object = (hdb_object_t*)hdb_malloc(size);
-    init_object(object, type);
+    hdb_object_t* object = (hdb_object_t*)hdb_slab_alloc(hdb_vm_object_pool(), size);
+    if (object) {
+        init_object(object, type);
+    }
 
     return object;
 }
 
-
+void hdb_object_free(hdb_object_t* object) {
+    if (object) {
+        hdb_slab_free(hdb_vm_object_pool(), object, object_size(object));
+    }
+}
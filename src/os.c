@@ -1,6 +1,8 @@
 #include <stdlib.h> // malloc, abort
 #include <errno.h> // errno
 #include <signal.h> // raise
+#include <unistd.h> // sysconf
+#include <sys/mman.h> // mmap, munmap, madvise
 
 #include "os.h"
 
@@ -28,6 +30,76 @@ void os_free(void* ptr) {
     free(ptr);
 }
 
+size_t os_page_size(void) {
+    static size_t page_size = 0;
+
+    if (!page_size) {
+        page_size = (size_t)sysconf(_SC_PAGESIZE);
+    }
+
+    return page_size;
+}
+
+void* os_reserve(size_t size) {
+    void* ptr = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+void* os_reserve_aligned(size_t size, size_t alignment) {
+    if (alignment <= os_page_size()) {
+        return os_reserve(size);
+    }
+
+    // Over-reserve, and return the unaligned head and the tail to the OS.
+    char* ptr = (char*)os_reserve(size + alignment);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    char* aligned = (char*)(((uintptr_t)ptr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (aligned > ptr) {
+        munmap(ptr, (size_t)(aligned - ptr));
+    }
+    munmap(aligned + size, (size_t)(ptr + alignment - aligned));
+
+    return aligned;
+}
+
+void* os_map_huge(size_t size) {
+#ifdef MAP_HUGETLB
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    return ptr == MAP_FAILED ? NULL : ptr;
+#else
+    (void)size;
+    errno = ENOTSUP;
+
+    return NULL;
+#endif
+}
+
+void os_advise_huge(void* ptr, size_t size) {
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+int32_t os_commit(void* ptr, size_t size) {
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE);
+}
+
+void os_unmap(void* ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+void os_release(void* ptr, size_t size) {
+    madvise(ptr, size, MADV_DONTNEED);
+}
+
 int32_t os_raise(int32_t signal) {
     return raise(signal);
 }
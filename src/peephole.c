@@ -0,0 +1,223 @@
+#include <string.h> // memcpy
+
+#include "memory.h"
+#include "peephole.h"
+
+/*
+ * The state of a single pass over a chunk. Instructions are copied to the output one by one, after which the
+ * tail of the output is rewritten where possible.
+ */
+typedef struct {
+    hdb_chunk_t* chunk;
+
+    // The optimized code and the line of each of its bytes.
+    uint8_t* code;
+    int32_t* lines;
+    int32_t count;
+
+    // The offsets of the instructions within the optimized code.
+    int32_t* instructions;
+    int32_t instruction_count;
+} peephole_t;
+
+/*
+ * Returns the opcode of the instruction at the given distance from the tail of the output, or OP_RETURN if
+ * there is no such instruction. OP_RETURN never occurs before the tail, so no rule matches it.
+ */
+static uint8_t tail(peephole_t* peephole, int32_t distance) {
+    if (peephole->instruction_count <= distance) {
+        return OP_RETURN;
+    }
+
+    return peephole->code[peephole->instructions[peephole->instruction_count - 1 - distance]];
+}
+
+static uint8_t* tail_instruction(peephole_t* peephole, int32_t distance) {
+    return peephole->code + peephole->instructions[peephole->instruction_count - 1 - distance];
+}
+
+static void drop_tail(peephole_t* peephole) {
+    peephole->count = peephole->instructions[--peephole->instruction_count];
+}
+
+static bool produces_boolean(uint8_t opcode) {
+    switch (opcode) {
+        case OP_TRUE:
+        case OP_FALSE:
+        case OP_NOT:
+        case OP_GREATER_CONSTANT:
+        case OP_GREATER_EQUAL_CONSTANT:
+        case OP_LESS_CONSTANT:
+        case OP_LESS_EQUAL_CONSTANT:
+            return true;
+        default: {
+            // Every other comparison has a negated counterpart.
+            uint8_t negated = opcode;
+            return hdb_opcode_negate(&negated);
+        }
+    }
+}
+
+/*
+ * Adds the given value to the constants of the chunk unless it is there already, and returns its index if an
+ * OP_CONSTANT can refer to it. Otherwise, returns -1.
+ */
+static int32_t add_constant(hdb_chunk_t* chunk, hdb_value_t value) {
+    const int32_t index = hdb_chunk_find_constant(chunk, value);
+    if (index >= 0 || chunk->constants.count >= 256) {
+        return index < 256 ? index : -1;
+    }
+
+    return hdb_chunk_add_constant(chunk, value);
+}
+
+/*
+ * Returns the constant pushed by the given instruction, which must be OP_CONSTANT or a small integer opcode.
+ */
+static hdb_value_t pushed_constant(peephole_t* peephole, const uint8_t* instruction) {
+    if (*instruction == OP_CONSTANT) {
+        return peephole->chunk->constants.values[instruction[1]];
+    }
+
+    return INT_VAL(*instruction - OP_ZERO);
+}
+
+static bool pushes_constant(uint8_t opcode) {
+    return opcode == OP_CONSTANT || (opcode >= OP_MINUS_ONE && opcode <= OP_TWO);
+}
+
+/*
+ * Replaces the constant pushed by the instruction before the tail with a constant the tail operates on, and
+ * removes the tail. The constant operand keeps the line of the tail, which is where errors are reported.
+ */
+static bool fold_into_constant(peephole_t* peephole, uint8_t opcode, hdb_value_t value) {
+    const int32_t index = add_constant(peephole->chunk, value);
+    if (index < 0) {
+        return false;
+    }
+
+    const int32_t line = peephole->lines[peephole->count - 1];
+    drop_tail(peephole);
+
+    // Small integer opcodes have no operand, so the constant index takes the place of the tail.
+    uint8_t* instruction = tail_instruction(peephole, 0);
+    if (*instruction != OP_CONSTANT) {
+        peephole->count++;
+    }
+
+    instruction[0] = opcode;
+    instruction[1] = (uint8_t)index;
+    peephole->lines[peephole->count - 1] = line;
+    return true;
+}
+
+static bool negate(hdb_value_t value, hdb_value_t* negated) {
+    if (IS_INT(value)) {
+        *negated = AS_INT(value) == HDB_INT_MIN ? NUMBER_VAL(-(double)AS_INT(value)) : INT_VAL(-AS_INT(value));
+        return true;
+    } else if (IS_NUMBER(value)) {
+        *negated = NUMBER_VAL(-AS_NUMBER(value));
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Rewrites the tail of the output once, and returns whether it did.
+ */
+static bool rewrite(peephole_t* peephole) {
+    const uint8_t last = tail(peephole, 0);
+    const uint8_t previous = tail(peephole, 1);
+    uint8_t constant_opcode;
+
+    if (last == OP_NOT) {
+        if (previous == OP_TRUE || previous == OP_FALSE) {
+            drop_tail(peephole);
+            *tail_instruction(peephole, 0) = previous == OP_TRUE ? OP_FALSE : OP_TRUE;
+            return true;
+        } else if (previous == OP_NOT && produces_boolean(tail(peephole, 2))) {
+            drop_tail(peephole);
+            drop_tail(peephole);
+            return true;
+        } else if (peephole->instruction_count > 1 && hdb_opcode_negate(tail_instruction(peephole, 1))) {
+            drop_tail(peephole);
+            return true;
+        }
+    } else if (last == OP_NEGATE && pushes_constant(previous)) {
+        hdb_value_t negated;
+        if (previous == OP_ONE || previous == OP_MINUS_ONE || previous == OP_ZERO) {
+            drop_tail(peephole);
+            *tail_instruction(peephole, 0) = previous == OP_ZERO ? OP_ZERO : OP_ONE + OP_MINUS_ONE - previous;
+            return true;
+        } else if (negate(pushed_constant(peephole, tail_instruction(peephole, 1)), &negated)) {
+            return fold_into_constant(peephole, OP_CONSTANT, negated);
+        }
+    } else if (pushes_constant(previous) && hdb_opcode_with_constant(last, &constant_opcode)) {
+        return fold_into_constant(peephole, constant_opcode, pushed_constant(peephole, tail_instruction(peephole, 1)));
+    }
+
+    return false;
+}
+
+bool hdb_peephole_optimize(hdb_chunk_t* chunk) {
+    if (chunk->count == 0) {
+        return true;
+    }
+
+    // The output never grows beyond the input, because every rewrite shrinks the code or keeps its size.
+    const size_t count = (size_t)chunk->count;
+    int32_t* buffer = hdb_malloc(count * (3 * sizeof(int32_t) + sizeof(uint8_t)));
+    if (!buffer) {
+        return false;
+    }
+
+    int32_t* lines = buffer;
+    peephole_t peephole = {
+            .chunk = chunk,
+            .lines = buffer + count,
+            .instructions = buffer + 2 * count,
+            .code = (uint8_t*)(buffer + 3 * count),
+            .count = 0,
+            .instruction_count = 0,
+    };
+
+    // Expand the run-length encoded lines, so every byte keeps its line while the code is rewritten.
+    for (int32_t run = 0, offset = 0; run < chunk->lines.count; run++) {
+        for (int32_t i = 0; i < chunk->lines.lines[run].instruction_count && offset < chunk->count; i++) {
+            lines[offset++] = chunk->lines.lines[run].line;
+        }
+    }
+
+    for (int32_t offset = 0; offset < chunk->count;) {
+        const int32_t length = hdb_chunk_instruction_length(chunk, offset);
+
+        peephole.instructions[peephole.instruction_count++] = peephole.count;
+        memcpy(peephole.code + peephole.count, chunk->code + offset, length);
+        memcpy(peephole.lines + peephole.count, lines + offset, length * sizeof(int32_t));
+        peephole.count += length;
+        offset += length;
+
+        while (rewrite(&peephole)) {}
+    }
+
+    hdb_line_array_t rebuilt;
+    hdb_line_array_init(&rebuilt);
+    rebuilt.arena = chunk->lines.arena;
+
+    for (int32_t offset = 0; offset < peephole.count; offset++) {
+        if (hdb_line_encode(&rebuilt, peephole.lines[offset]) < 0) {
+            hdb_line_array_free(&rebuilt);
+            hdb_free(buffer);
+            return false;
+        }
+    }
+
+    memcpy(chunk->code, peephole.code, peephole.count);
+    chunk->count = peephole.count;
+    hdb_line_array_free(&chunk->lines);
+    chunk->lines = rebuilt;
+
+    hdb_free(buffer);
+    return true;
+}
@@ -1178,12 +1178,14 @@ static hdb_token_t identifier(void) {
 static hdb_token_t number(void) {
     while(is_digit(peek())) { advance(); }
 
-    // Look for a fractional part
-    if (peek() == '.' && is_digit(peek_next())) {
-        // Consume the period.
-        advance();
+    // Without a fractional part, this is an integer
+    if (peek() != '.' || !is_digit(peek_next())) {
+        return make_token(TOKEN_INTEGER_LITERAL);
     }
 
+    // Consume the period.
+    advance();
+
     while (is_digit(peek())) { advance(); }
 
     return make_token(TOKEN_NUMBER);
@@ -0,0 +1,163 @@
+#include <string.h> // memset
+
+#include "memory.h"
+#include "slab.h"
+
+// The slots of a slab start at the first multiple of HDB_SLAB_GRANULARITY after its header.
+#define SLAB_HEADER_SIZE \
+    ((sizeof(hdb_slab_t) + HDB_SLAB_GRANULARITY - 1) & ~(size_t)(HDB_SLAB_GRANULARITY - 1))
+
+#define SLAB_SLOTS(slab) \
+    ((char*)(slab) + SLAB_HEADER_SIZE)
+
+static uint8_t size_class(size_t size) {
+    return (uint8_t)((size + HDB_SLAB_GRANULARITY - 1) / HDB_SLAB_GRANULARITY - 1);
+}
+
+static void slab_list_remove(hdb_slab_t** list, hdb_slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+
+    slab->next = NULL;
+    slab->prev = NULL;
+}
+
+static void slab_list_add(hdb_slab_t** list, hdb_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (slab->next) {
+        slab->next->prev = slab;
+    }
+
+    *list = slab;
+}
+
+/*
+ * Prepares the given slab to hand out slots of the given size.
+ */
+static void slab_init(hdb_slab_t* slab, uint16_t object_size) {
+    slab->next = NULL;
+    slab->prev = NULL;
+    slab->object_size = object_size;
+    slab->capacity = (uint16_t)((HDB_SLAB_SIZE - SLAB_HEADER_SIZE) / object_size);
+    slab->used = 0;
+
+    memset(slab->free_map, 0, sizeof(slab->free_map));
+    for (uint16_t slot = 0; slot < slab->capacity; slot++) {
+        slab->free_map[slot / 64] |= (uint64_t)1 << (slot % 64);
+    }
+}
+
+/*
+ * Allocates a new superblock and adds the slabs within it to the empty slabs of the given pool.
+ */
+static bool superblock_create(hdb_slab_pool_t* pool) {
+    void* superblock = hdb_malloc_aligned(HDB_SLAB_SUPERBLOCK_SIZE, HDB_SLAB_SIZE);
+    if (!superblock) {
+        return false;
+    }
+
+    if (pool->superblock_capacity < pool->superblock_count + 1) {
+        const int32_t capacity = HDB_GROW_CAPACITY(pool->superblock_capacity);
+        void** superblocks = HDB_GROW_ARRAY(void*, pool->superblocks, capacity);
+        if (!superblocks) {
+            hdb_free(superblock);
+            return false;
+        }
+
+        pool->superblocks = superblocks;
+        pool->superblock_capacity = capacity;
+    }
+    pool->superblocks[pool->superblock_count++] = superblock;
+
+    for (size_t offset = 0; offset < HDB_SLAB_SUPERBLOCK_SIZE; offset += HDB_SLAB_SIZE) {
+        slab_list_add(&pool->empty, (hdb_slab_t*)((char*)superblock + offset));
+    }
+
+    return true;
+}
+
+void hdb_slab_pool_init(hdb_slab_pool_t* pool) {
+    for (uint8_t class = 0; class < HDB_SLAB_CLASSES; class++) {
+        pool->partial[class] = NULL;
+    }
+
+    pool->empty = NULL;
+    pool->superblock_count = 0;
+    pool->superblock_capacity = 0;
+    pool->superblocks = NULL;
+}
+
+void hdb_slab_pool_free(hdb_slab_pool_t* pool) {
+    for (int32_t i = 0; i < pool->superblock_count; i++) {
+        hdb_free(pool->superblocks[i]);
+    }
+
+    HDB_FREE_ARRAY(void*, pool->superblocks);
+    hdb_slab_pool_init(pool);
+}
+
+void* hdb_slab_alloc(hdb_slab_pool_t* pool, size_t size) {
+    if (size == 0) {
+        return NULL;
+    } else if (size > HDB_SLAB_MAX_OBJECT_SIZE) {
+        return hdb_malloc(size);
+    }
+
+    const uint8_t class = size_class(size);
+    hdb_slab_t* slab = pool->partial[class];
+    if (!slab) {
+        if (!pool->empty && !superblock_create(pool)) {
+            return NULL;
+        }
+
+        slab = pool->empty;
+        slab_list_remove(&pool->empty, slab);
+        slab_init(slab, (uint16_t)((class + 1) * HDB_SLAB_GRANULARITY));
+        slab_list_add(&pool->partial[class], slab);
+    }
+
+    // A slab on the partial list always has a free slot, so this finds one within HDB_SLAB_MAP_WORDS steps.
+    uint8_t word = 0;
+    while (!slab->free_map[word]) {
+        word++;
+    }
+
+    const uint16_t slot = (uint16_t)(word * 64 + __builtin_ctzll(slab->free_map[word]));
+    slab->free_map[word] &= slab->free_map[word] - 1;
+
+    if (++slab->used == slab->capacity) {
+        slab_list_remove(&pool->partial[class], slab);
+    }
+
+    return SLAB_SLOTS(slab) + (size_t)slot * slab->object_size;
+}
+
+void hdb_slab_free(hdb_slab_pool_t* pool, void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    } else if (size > HDB_SLAB_MAX_OBJECT_SIZE) {
+        hdb_free(ptr);
+        return;
+    }
+
+    const uint8_t class = size_class(size);
+    hdb_slab_t* slab = (hdb_slab_t*)((uintptr_t)ptr & ~(uintptr_t)(HDB_SLAB_SIZE - 1));
+    const uint16_t slot = (uint16_t)(((char*)ptr - SLAB_SLOTS(slab)) / slab->object_size);
+
+    if (slab->used == slab->capacity) {
+        slab_list_add(&pool->partial[class], slab);
+    }
+
+    slab->free_map[slot / 64] |= (uint64_t)1 << (slot % 64);
+    if (--slab->used == 0) {
+        slab_list_remove(&pool->partial[class], slab);
+        slab_list_add(&pool->empty, slab);
+    }
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "statement.h"
+#include "ustring.h"
+
+hdb_statement_t* hdb_statement_prepare(const char* source) {
+    // Compile first, so the cached statement is copied already if allocating the statement evicts it.
+    hdb_chunk_t chunk;
+    if (!hdb_vm_compile(source, &chunk)) {
+        return NULL;
+    }
+
+    hdb_statement_t* statement = HDB_ALLOCATE(hdb_statement_t, 1);
+    if (!statement) {
+        hdb_chunk_free(&chunk);
+        return NULL;
+    }
+
+    statement->chunk = chunk;
+    statement->parameters = NULL;
+    if (statement->chunk.parameters.count) {
+        statement->parameters = HDB_ALLOCATE(hdb_value_t, statement->chunk.parameters.count);
+        if (!statement->parameters) {
+            hdb_chunk_free(&statement->chunk);
+            hdb_free(statement);
+            return NULL;
+        }
+    }
+
+    hdb_statement_clear_bindings(statement);
+    return statement;
+}
+
+int32_t hdb_statement_parameter_count(const hdb_statement_t* statement) {
+    return statement->chunk.parameters.count;
+}
+
+int32_t hdb_statement_parameter_index(const hdb_statement_t* statement, const char* name) {
+    const size_t length = strlen(name);
+
+    for (int32_t i = 0; i < statement->chunk.parameters.count; i++) {
+        const hdb_value_t parameter = statement->chunk.parameters.values[i];
+        if (IS_STRING(parameter) && AS_STRING(parameter)->byte_length == length
+                && memcmp(AS_CSTRING(parameter), name, length) == 0) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+bool hdb_statement_bind(hdb_statement_t* statement, int32_t index, hdb_value_t value) {
+    if (index < 1 || index > statement->chunk.parameters.count) {
+        return false;
+    }
+
+    statement->parameters[index - 1] = value;
+    return true;
+}
+
+void hdb_statement_clear_bindings(hdb_statement_t* statement) {
+    for (int32_t i = 0; i < statement->chunk.parameters.count; i++) {
+        statement->parameters[i] = NULL_VAL;
+    }
+}
+
+hdb_interpret_result_t hdb_statement_execute(hdb_statement_t* statement) {
+    return hdb_vm_execute(&statement->chunk, statement->parameters, statement->chunk.parameters.count);
+}
+
+void hdb_statement_finalize(hdb_statement_t* statement) {
+    if (!statement) {
+        return;
+    }
+
+    HDB_FREE_ARRAY(hdb_value_t, statement->parameters);
+    hdb_chunk_free(&statement->chunk);
+    hdb_free(statement);
+}
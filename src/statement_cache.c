@@ -0,0 +1,295 @@
+#include <stddef.h> // offsetof
+#include <string.h>
+
+#include "memory.h"
+#include "scanner.h"
+#include "statement_cache.h"
+
+#define STATEMENT_OF(chunk_pointer) \
+    ((hdb_cached_statement_t*)((char*)(chunk_pointer) - offsetof(hdb_cached_statement_t, chunk)))
+
+/*
+ * Appends the given bytes to the key of the cache, growing it if required.
+ */
+static bool key_append(hdb_statement_cache_t* cache, const void* bytes, size_t length) {
+    if (cache->key_capacity < cache->key_length + length) {
+        size_t capacity = cache->key_capacity;
+        while (capacity < cache->key_length + length) {
+            capacity = HDB_GROW_CAPACITY(capacity);
+        }
+
+        uint8_t* key = HDB_GROW_ARRAY(uint8_t, cache->key, capacity);
+        if (!key) {
+            return false;
+        }
+
+        cache->key = key;
+        cache->key_capacity = capacity;
+    }
+
+    memcpy(cache->key + cache->key_length, bytes, length);
+    cache->key_length += length;
+    return true;
+}
+
+/*
+ * Returns whether the text of the given token matters to the compiled statement. The type of all other tokens,
+ * like keywords and operators, determines their text already.
+ */
+static bool has_value(hdb_token_type_t type) {
+    switch (type) {
+        case TOKEN_STRING:
+        case TOKEN_IDENTIFIER:
+        case TOKEN_ENCLOSED_IDENTIFIER:
+        case TOKEN_NUMBER:
+        case TOKEN_INTEGER_LITERAL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Scans the given source into the key of the cache. Each token adds its type and line, because the compiled
+ * statement reports errors by line, followed by its text if that matters. Whitespace and comments are left out.
+ * Sets the key length to zero if the source cannot be keyed, for example because it contains an invalid token.
+ */
+static void key_build(hdb_statement_cache_t* cache, const char* source) {
+    cache->key_length = 0;
+    hdb_scanner_init(source);
+
+    for (;;) {
+        const hdb_token_t token = hdb_scanner_scan_token();
+        const int32_t header[] = {(int32_t)token.type, token.line};
+
+        if (token.type == TOKEN_ERROR || !key_append(cache, header, sizeof(header))
+                || (has_value(token.type) && (!key_append(cache, &token.length, sizeof(token.length))
+                                              || !key_append(cache, token.start, (size_t)token.length)))) {
+            cache->key_length = 0;
+            return;
+        }
+
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+    }
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < cache->key_length; i++) {
+        hash ^= cache->key[i];
+        hash *= 1099511628211u;
+    }
+    cache->hash = hash;
+}
+
+static hdb_cached_statement_t** bucket_of(hdb_statement_cache_t* cache, uint64_t hash) {
+    return &cache->buckets[hash & (uint64_t)(cache->bucket_count - 1)];
+}
+
+static void lru_unlink(hdb_statement_cache_t* cache, hdb_cached_statement_t* statement) {
+    if (statement->prev) {
+        statement->prev->next = statement->next;
+    } else {
+        cache->head = statement->next;
+    }
+    if (statement->next) {
+        statement->next->prev = statement->prev;
+    } else {
+        cache->tail = statement->prev;
+    }
+
+    statement->prev = NULL;
+    statement->next = NULL;
+}
+
+static void lru_push(hdb_statement_cache_t* cache, hdb_cached_statement_t* statement) {
+    statement->prev = NULL;
+    statement->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = statement;
+    } else {
+        cache->tail = statement;
+    }
+
+    cache->head = statement;
+}
+
+/*
+ * Removes the given statement from the cache and returns its memory to the heap.
+ */
+static void evict(hdb_statement_cache_t* cache, hdb_cached_statement_t* statement) {
+    hdb_cached_statement_t** link = bucket_of(cache, statement->hash);
+    while (*link != statement) {
+        link = &(*link)->chain;
+    }
+    *link = statement->chain;
+
+    lru_unlink(cache, statement);
+    cache->count--;
+    cache->evictions++;
+
+    hdb_chunk_free(&statement->chunk);
+    HDB_FREE_ARRAY(uint8_t, statement->key);
+    hdb_free(statement);
+}
+
+/*
+ * Evicts all statements that are not being executed, so their memory can be used for the failed allocation.
+ * Allocations on other threads fail without relieving pressure here, since they cannot touch the cache safely.
+ */
+static bool relieve_pressure(size_t size, void* context) {
+    (void)size;
+
+    hdb_statement_cache_t* cache = context;
+    if (!pthread_equal(pthread_self(), cache->thread)) {
+        return false;
+    }
+
+    const int32_t count = cache->count;
+    hdb_statement_cache_clear(cache);
+
+    return cache->count < count;
+}
+
+bool hdb_statement_cache_init(hdb_statement_cache_t* cache, int32_t capacity) {
+    cache->buckets = NULL;
+    cache->bucket_count = 0;
+    cache->head = NULL;
+    cache->tail = NULL;
+    cache->pinned = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->key = NULL;
+    cache->key_length = 0;
+    cache->key_capacity = 0;
+    cache->hash = 0;
+    cache->thread = pthread_self();
+
+    if (capacity <= 0) {
+        return true;
+    }
+
+    // Keep the chains short by having at least twice as many buckets as statements.
+    int32_t bucket_count = 8;
+    while (bucket_count < capacity * 2) {
+        bucket_count *= 2;
+    }
+
+    cache->buckets = HDB_ALLOCATE(hdb_cached_statement_t*, bucket_count);
+    if (!cache->buckets) {
+        return false;
+    }
+
+    for (int32_t i = 0; i < bucket_count; i++) {
+        cache->buckets[i] = NULL;
+    }
+
+    cache->bucket_count = bucket_count;
+    cache->capacity = capacity;
+
+    // Without the handler, the cache still works, but holds on to its memory under pressure.
+    hdb_heap_pressure_register(relieve_pressure, cache, 0);
+    return true;
+}
+
+void hdb_statement_cache_free(hdb_statement_cache_t* cache) {
+    hdb_heap_pressure_unregister(relieve_pressure, cache);
+
+    cache->pinned = NULL;
+    hdb_statement_cache_clear(cache);
+
+    HDB_FREE_ARRAY(hdb_cached_statement_t*, cache->buckets);
+    HDB_FREE_ARRAY(uint8_t, cache->key);
+    hdb_statement_cache_init(cache, 0);
+}
+
+hdb_chunk_t* hdb_statement_cache_lookup(hdb_statement_cache_t* cache, const char* source) {
+    if (cache->capacity == 0) {
+        return NULL;
+    }
+
+    key_build(cache, source);
+    if (cache->key_length > 0) {
+        for (hdb_cached_statement_t* statement = *bucket_of(cache, cache->hash); statement;
+                statement = statement->chain) {
+            if (statement->hash == cache->hash && statement->key_length == cache->key_length
+                    && memcmp(statement->key, cache->key, cache->key_length) == 0) {
+                lru_unlink(cache, statement);
+                lru_push(cache, statement);
+                cache->hits++;
+                return &statement->chunk;
+            }
+        }
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+hdb_chunk_t* hdb_statement_cache_insert(hdb_statement_cache_t* cache, const hdb_chunk_t* chunk) {
+    if (cache->capacity == 0 || cache->key_length == 0) {
+        return NULL;
+    }
+
+    if (cache->count == cache->capacity) {
+        hdb_cached_statement_t* victim = cache->tail;
+        if (victim == cache->pinned) {
+            victim = victim->prev;
+        }
+        if (!victim) {
+            return NULL;
+        }
+
+        evict(cache, victim);
+    }
+
+    hdb_cached_statement_t* statement = HDB_ALLOCATE(hdb_cached_statement_t, 1);
+    if (!statement) {
+        return NULL;
+    }
+
+    statement->key = HDB_ALLOCATE(uint8_t, cache->key_length);
+    if (!statement->key) {
+        hdb_free(statement);
+        return NULL;
+    }
+
+    if (!hdb_chunk_copy(&statement->chunk, chunk)) {
+        HDB_FREE_ARRAY(uint8_t, statement->key);
+        hdb_free(statement);
+        return NULL;
+    }
+
+    memcpy(statement->key, cache->key, cache->key_length);
+    statement->key_length = cache->key_length;
+    statement->hash = cache->hash;
+
+    hdb_cached_statement_t** bucket = bucket_of(cache, statement->hash);
+    statement->chain = *bucket;
+    *bucket = statement;
+
+    lru_push(cache, statement);
+    cache->count++;
+
+    return &statement->chunk;
+}
+
+void hdb_statement_cache_pin(hdb_statement_cache_t* cache, const hdb_chunk_t* chunk) {
+    cache->pinned = chunk ? STATEMENT_OF(chunk) : NULL;
+}
+
+void hdb_statement_cache_clear(hdb_statement_cache_t* cache) {
+    hdb_cached_statement_t* statement = cache->head;
+    while (statement) {
+        hdb_cached_statement_t* next = statement->next;
+        if (statement != cache->pinned) {
+            evict(cache, statement);
+        }
+
+        statement = next;
+    }
+}
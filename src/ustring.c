@@ -1,5 +1,4 @@
 #include <string.h>
-#include <stddef.h> // offsetof()
 
 #include "ustring.h"
 
@@ -31,10 +30,14 @@ static size_t unit_length(const char* chars, size_t byte_length) {
 static hdb_ustring_t* ustring_create(const char* chars, size_t len, size_t units) {
     hdb_ustring_t* string = (hdb_ustring_t *) hdb_object_create(
             sizeof(hdb_ustring_t) + len + 1, OBJ_STRING);
+    if (!string) {
+        return NULL;
+    }
+
     string->length = units;
     string->byte_length = len;
 
-    char* content = (char*)(string + offsetof(hdb_ustring_t, chars));
+    char* content = (char*)string + sizeof(hdb_ustring_t);
     memcpy(content, chars, len);
     content[len] = '\0';
     string->chars = content;
@@ -9,19 +9,41 @@ void hdb_init_value_array(hdb_value_array_t* array) {
     array->values = NULL;
     array->capacity = 0;
     array->count = 0;
+    array->arena = NULL;
 }
 
-void hdb_write_value_array(hdb_value_array_t* array, hdb_value_t value) {
+bool hdb_write_value_array(hdb_value_array_t* array, hdb_value_t value) {
     if (array->capacity < array->count + 1) {
-        array->capacity = HDB_GROW_CAPACITY(array->capacity);
-        array->values = HDB_GROW_ARRAY(hdb_value_t, array->values, array->capacity);
+        const int32_t capacity = HDB_GROW_CAPACITY(array->capacity);
+        hdb_value_t* grown = HDB_ARENA_GROW_ARRAY(array->arena, hdb_value_t, array->values, array->capacity, capacity);
+        if (!grown) {
+            return false;
+        }
+
+        array->values = grown;
+        array->capacity = capacity;
     }
 
     array->values[array->count] = value;
     array->count++;
+    return true;
 }
 
 bool hdb_values_equal(hdb_value_t left, hdb_value_t right) {
+    if (IS_INT(left) && IS_INT(right)) {
+        return AS_INT(left) == AS_INT(right);
+    } else if (IS_NUMERIC(left) && IS_NUMERIC(right)) {
+        return AS_DOUBLE(left) == AS_DOUBLE(right);
+    } else if (IS_OBJ(left) && IS_OBJ(right)) {
+        hdb_ustring_t* a = AS_STRING(left);
+        hdb_ustring_t* b = AS_STRING(right);
+        return a->length == b->length &&
+            memcmp(a->chars, b->chars, a->length) == 0;
+    }
+
+#ifdef HDB_NAN_BOXING
+    return left == right;
+#else
     if (left.type != right.type) {
         return false;
     }
@@ -29,19 +51,16 @@ bool hdb_values_equal(hdb_value_t left, hdb_value_t right) {
     switch(left.type) {
         case VAL_BOOL: return AS_BOOL(left) == AS_BOOL(right);
         case VAL_NULL: return true;
-        case VAL_NUMBER: return AS_NUMBER(left) == AS_NUMBER(right);
-        case VAL_OBJ: {
-            hdb_ustring_t* a = AS_STRING(left);
-            hdb_ustring_t* b = AS_STRING(right);
-            return a->length == b->length &&
-                memcmp(a->chars, b->chars, a->length) == 0;
-        }
         default:
             return false; // unreachable
     }
+#endif
 }
 
 void hdb_free_value_array(hdb_value_array_t* array) {
-    HDB_FREE_ARRAY(Value, array->values);
+    hdb_arena_t* arena = array->arena;
+
+    HDB_ARENA_FREE_ARRAY(arena, hdb_value_t, array->values);
     hdb_init_value_array(array);
+    array->arena = arena;
 }
\ No newline at end of file
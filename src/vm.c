@@ -11,10 +11,15 @@
 #include "compiler.h"
 #include "ustring.h"
 
+// Dispatch instructions through a table of label addresses where the compiler supports it.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(HDB_VM_SWITCH_DISPATCH)
+#define HDB_VM_COMPUTED_GOTO
+#endif
+
 hdb_vm_t* vm;
 
 static void stack_init(void) {
-    vm->stack = os_malloc(sizeof(hdb_value_t*) * vm->stack_capacity);
+    vm->stack = os_malloc(sizeof(hdb_value_t) * vm->stack_capacity);
     vm->stack_count = 0;
 }
 
@@ -46,7 +51,7 @@ static void stack_grow(uint8_t factor) {
     }
 
     vm->stack_capacity = requested_capacity;
-    vm->stack = os_realloc(vm->stack, sizeof(hdb_value_t*) * vm->stack_capacity);
+    vm->stack = os_realloc(vm->stack, sizeof(hdb_value_t) * vm->stack_capacity);
 }
 
 void hdb_vm_init(size_t heap_min_size, size_t heap_max_size) {
@@ -55,6 +60,16 @@ void hdb_vm_init(size_t heap_min_size, size_t heap_max_size) {
 
         vm = os_malloc(sizeof(hdb_vm_t));
         vm->objects = NULL;
+        hdb_slab_pool_init(&vm->object_pool);
+        hdb_arena_init(&vm->chunk_arena);
+        hdb_statement_cache_init(&vm->statement_cache, HDB_STATEMENT_CACHE_CAPACITY);
+#ifdef DEBUG_TRACE_EXECUTION
+        vm->trace = true;
+#else
+        vm->trace = false;
+#endif
+        vm->parameters = NULL;
+        vm->parameter_count = 0;
 
         // Set initial stack size so stack_init() will claim some memory for it.
         int32_t heap_based_stack_capacity = heap->current_size / 4096;
@@ -68,6 +83,15 @@ void hdb_vm_init(size_t heap_min_size, size_t heap_max_size) {
 void hdb_vm_free(void) {
     if (vm) {
         hdb_compiler_free();
+        hdb_statement_cache_free(&vm->statement_cache);
+
+        while (vm->objects) {
+            hdb_object_t* next = vm->objects->next;
+            hdb_object_free(vm->objects);
+            vm->objects = next;
+        }
+        hdb_slab_pool_free(&vm->object_pool);
+        hdb_arena_free(&vm->chunk_arena);
 
         os_free(vm->stack);
         os_free(vm);
@@ -94,6 +118,10 @@ hdb_value_t hdb_vm_stack_pop(void) {
     return *(vm->stack + vm->stack_count);
 }
 
+hdb_slab_pool_t* hdb_vm_object_pool(void) {
+    return &vm->object_pool;
+}
+
 void hdb_vm_notify_new(hdb_object_t* object) {
     if (object) {
         object->next = vm->objects;
@@ -101,133 +129,323 @@ void hdb_vm_notify_new(hdb_object_t* object) {
     }
 }
 
-static hdb_value_t stack_peek(int32_t distance) {
-    // todo prevent stack underflow
-    return *(vm->stack + vm->stack_count - 1 - distance);
-}
-
-static void concatenate() {
+static bool concatenate() {
     hdb_ustring_t* right = AS_STRING(hdb_vm_stack_pop());
     hdb_ustring_t* left = AS_STRING(hdb_vm_stack_pop());
     hdb_ustring_t* result = hdb_ustring_concatenate(left, right);
+    if (!result) {
+        return false;
+    }
 
     hdb_vm_stack_push(OBJ_VAL(result));
+    return true;
+}
+
+/*
+ * Prints the current stack and the instruction at the instruction pointer.
+ */
+static void trace_instruction(void) {
+    printf("          ");
+    for (int32_t slot = 0; slot < vm->stack_count; slot++) {
+        printf("[ ");
+        hdb_dbg_print_value(vm->stack[slot]);
+        printf(" ]");
+    }
+    printf("\n");
+    hdb_dbg_disassemble_instruction(vm->chunk, (int32_t) (vm->ip - vm->chunk->code));
 }
 
 static hdb_interpret_result_t run(void) {
-#define READ_BYTE() (*vm->ip++)
-#define READ_CONSTANT() (hdb_chunk_read_constant(vm->chunk, vm->ip++))
+    // The instruction pointer and the stack top live in locals, so the compiler can keep them in registers.
+    // Anything outside of this function that reads them needs a SYNC() first.
+    hdb_chunk_t* chunk = vm->chunk;
+    uint8_t* ip = vm->ip;
+    hdb_value_t* sp = vm->stack + vm->stack_count;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT_CONSTANT() (chunk->constants.values[READ_BYTE()])
+#define READ_LONG_CONSTANT() (ip += 3, chunk->constants.values[HDB_CONSTANT_LONG_INDEX(ip - 3)])
+#define PUSH(value) (*sp++ = (value))
+#define POP() (*--sp)
+#define PEEK(distance) (sp[-1 - (distance)])
+#define SYNC() \
+    do { \
+        vm->ip = ip; \
+        vm->stack_count = (int32_t) (sp - vm->stack); \
+    } while (false)
+#define RUNTIME_ERROR(message) \
+    do { \
+        SYNC(); \
+        runtime_error(message); \
+        return INTERPRET_RUNTIME_ERROR; \
+    } while (false)
 #define BINARY_OP(value_type, op) \
     do {              \
-        if (!IS_NUMBER(stack_peek(0)) || !IS_NUMBER(stack_peek(1))) { \
-            runtime_error("Operands must be numbers.");   \
-            return INTERPRET_RUNTIME_ERROR;               \
+        if (!IS_NUMERIC(PEEK(0)) || !IS_NUMERIC(PEEK(1))) { \
+            RUNTIME_ERROR("Operands must be numbers."); \
+        } \
+        hdb_value_t right = POP(); \
+        hdb_value_t left  = POP(); \
+        PUSH(value_type(AS_DOUBLE(left) op AS_DOUBLE(right)));  \
+    } while (false)
+#define INT_BINARY_OP(op, checked_op) \
+    do { \
+        int64_t right = AS_INT(POP()); \
+        int64_t left  = AS_INT(POP()); \
+        int64_t result; \
+        if (!checked_op(left, right, &result) && result >= HDB_INT_MIN && result <= HDB_INT_MAX) { \
+            PUSH(INT_VAL(result)); \
+        } else { \
+            PUSH(NUMBER_VAL((double)left op (double)right)); \
+        } \
+    } while (false)
+#define ARITHMETIC_OP(op, checked_op) \
+    do { \
+        if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) { \
+            INT_BINARY_OP(op, checked_op); \
+        } else { \
+            BINARY_OP(NUMBER_VAL, op); \
+        } \
+    } while (false)
+#define COMPARISON_OP(op) \
+    do { \
+        if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) { \
+            int64_t right = AS_INT(POP()); \
+            int64_t left  = AS_INT(POP()); \
+            PUSH(BOOL_VAL(left op right)); \
+        } else { \
+            BINARY_OP(BOOL_VAL, op); \
         } \
-        double right = AS_NUMBER(hdb_vm_stack_pop()); \
-        double left  = AS_NUMBER(hdb_vm_stack_pop()); \
-        hdb_vm_stack_push(value_type(left op right));  \
     } while (false)
 
-    for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-        printf("          ");
-        for (int32_t slot = 0; slot < vm->stack_count; slot++) {
-            hdb_value_t value = vm->stack[slot];
-            printf("[ ");
-            hdb_dbg_print_value(value);
-            printf(" ]");
-        }
-        printf("\n");
-        hdb_dbg_disassemble_instruction(vm->chunk, (int32_t) (vm->ip - vm->chunk->code));
+#ifdef HDB_VM_COMPUTED_GOTO
+    // Every instruction jumps to the next one through its own indirect branch, which predicts far better than
+    // the single shared branch of a switch.
+    static void* const dispatch_table[] = {
+            [OP_CONSTANT] = &&OP_CONSTANT,
+            [OP_CONSTANT_LONG] = &&OP_CONSTANT_LONG,
+            [OP_NULL] = &&OP_NULL,
+            [OP_TRUE] = &&OP_TRUE,
+            [OP_FALSE] = &&OP_FALSE,
+            [OP_MINUS_ONE] = &&OP_MINUS_ONE,
+            [OP_ZERO] = &&OP_ZERO,
+            [OP_ONE] = &&OP_ONE,
+            [OP_TWO] = &&OP_TWO,
+            [OP_EQUAL] = &&OP_EQUAL,
+            [OP_NOT_EQUAL] = &&OP_NOT_EQUAL,
+            [OP_GREATER] = &&OP_GREATER,
+            [OP_GREATER_EQUAL] = &&OP_GREATER_EQUAL,
+            [OP_LESS] = &&OP_LESS,
+            [OP_LESS_EQUAL] = &&OP_LESS_EQUAL,
+            [OP_ADD] = &&OP_ADD,
+            [OP_SUBTRACT] = &&OP_SUBTRACT,
+            [OP_MULTIPLY] = &&OP_MULTIPLY,
+            [OP_DIVIDE] = &&OP_DIVIDE,
+            [OP_NOT] = &&OP_NOT,
+            [OP_NEGATE] = &&OP_NEGATE,
+            [OP_ADD_CONSTANT] = &&OP_ADD_CONSTANT,
+            [OP_SUBTRACT_CONSTANT] = &&OP_SUBTRACT_CONSTANT,
+            [OP_MULTIPLY_CONSTANT] = &&OP_MULTIPLY_CONSTANT,
+            [OP_DIVIDE_CONSTANT] = &&OP_DIVIDE_CONSTANT,
+            [OP_EQUAL_CONSTANT] = &&OP_EQUAL_CONSTANT,
+            [OP_NOT_EQUAL_CONSTANT] = &&OP_NOT_EQUAL_CONSTANT,
+            [OP_GREATER_CONSTANT] = &&OP_GREATER_CONSTANT,
+            [OP_GREATER_EQUAL_CONSTANT] = &&OP_GREATER_EQUAL_CONSTANT,
+            [OP_LESS_CONSTANT] = &&OP_LESS_CONSTANT,
+            [OP_LESS_EQUAL_CONSTANT] = &&OP_LESS_EQUAL_CONSTANT,
+            [OP_NOT_GREATER] = &&OP_NOT_GREATER,
+            [OP_NOT_GREATER_EQUAL] = &&OP_NOT_GREATER_EQUAL,
+            [OP_NOT_LESS] = &&OP_NOT_LESS,
+            [OP_NOT_LESS_EQUAL] = &&OP_NOT_LESS_EQUAL,
+            [OP_PARAMETER] = &&OP_PARAMETER,
+            [OP_RETURN] = &&OP_RETURN,
+    };
+
+    // When tracing, every instruction first detours through the trace label, so the handlers stay the same and
+    // executing without tracing does not check for it at all.
+    static void* const trace_table[] = {
+            [0 ... OP_RETURN] = &&trace,
+    };
+
+    void* const* dispatch = vm->trace ? trace_table : dispatch_table;
+
+#define DISPATCH_LOOP()     DISPATCH();
+#define CASE(opcode)        opcode
+#define DISPATCH()          goto *dispatch[READ_BYTE()]
+
+#else
+    const bool trace = vm->trace;
+
+#define DISPATCH_LOOP()     dispatch: if (trace) { SYNC(); trace_instruction(); } switch (READ_BYTE())
+#define CASE(opcode)        case opcode
+#define DISPATCH()          goto dispatch
 #endif
-        uint8_t instruction;
-        switch (instruction = READ_BYTE()) {
-            case OP_CONSTANT:
-            case OP_CONSTANT_LONG: {
-                hdb_value_t value = READ_CONSTANT();
-                hdb_vm_stack_push(value);
-                break;
-            }
 
-            case OP_NULL:       hdb_vm_stack_push(NULL_VAL); break;
-            case OP_TRUE:       hdb_vm_stack_push(BOOL_VAL(true)); break;
-            case OP_FALSE:      hdb_vm_stack_push(BOOL_VAL(false)); break;
-            case OP_MINUS_ONE:  hdb_vm_stack_push(NUMBER_VAL(-1.0)); break;
-            case OP_ZERO:       hdb_vm_stack_push(NUMBER_VAL(0.0)); break;
-            case OP_ONE:        hdb_vm_stack_push(NUMBER_VAL(1.0)); break;
-            case OP_TWO:        hdb_vm_stack_push(NUMBER_VAL(2.0)); break;
-
-            case OP_EQUAL: {
-                hdb_value_t right = hdb_vm_stack_pop();
-                hdb_value_t left  = hdb_vm_stack_pop();
-                hdb_vm_stack_push(BOOL_VAL(hdb_values_equal(left, right)));
-                break;
-            }
+    DISPATCH_LOOP() {
+        CASE(OP_CONSTANT):      PUSH(READ_SHORT_CONSTANT()); DISPATCH();
+        CASE(OP_CONSTANT_LONG): PUSH(READ_LONG_CONSTANT()); DISPATCH();
+
+        CASE(OP_NULL):       PUSH(NULL_VAL); DISPATCH();
+        CASE(OP_TRUE):       PUSH(BOOL_VAL(true)); DISPATCH();
+        CASE(OP_FALSE):      PUSH(BOOL_VAL(false)); DISPATCH();
+        CASE(OP_MINUS_ONE):  PUSH(INT_VAL(-1)); DISPATCH();
+        CASE(OP_ZERO):       PUSH(INT_VAL(0)); DISPATCH();
+        CASE(OP_ONE):        PUSH(INT_VAL(1)); DISPATCH();
+        CASE(OP_TWO):        PUSH(INT_VAL(2)); DISPATCH();
+
+        CASE(OP_EQUAL):
+        equal: {
+            hdb_value_t right = POP();
+            hdb_value_t left  = POP();
+            PUSH(BOOL_VAL(hdb_values_equal(left, right)));
+            DISPATCH();
+        }
 
-            case OP_NOT_EQUAL: {
-                hdb_value_t right = hdb_vm_stack_pop();
-                hdb_value_t left = hdb_vm_stack_pop();
-                hdb_vm_stack_push(BOOL_VAL(!hdb_values_equal(left, right)));
-                break;
-            }
+        CASE(OP_NOT_EQUAL):
+        not_equal: {
+            hdb_value_t right = POP();
+            hdb_value_t left = POP();
+            PUSH(BOOL_VAL(!hdb_values_equal(left, right)));
+            DISPATCH();
+        }
 
-            case OP_LESS:           BINARY_OP(NUMBER_VAL, <); break;
-            case OP_LESS_EQUAL:     BINARY_OP(NUMBER_VAL, <=); break;
-            case OP_GREATER:        BINARY_OP(NUMBER_VAL, >); break;
-            case OP_GREATER_EQUAL:  BINARY_OP(NUMBER_VAL, >=); break;
-            case OP_ADD: {
-                if (IS_STRING(stack_peek(0)) && IS_STRING(stack_peek(1))) {
-                    concatenate();
-                } else if (IS_NUMBER(stack_peek(0)) && IS_NUMBER(stack_peek(1))) {
-                    BINARY_OP(NUMBER_VAL, +);
-                } else {
-                    runtime_error("Operands must be two numbers or two strings.");
+        CASE(OP_LESS):           less: COMPARISON_OP(<); DISPATCH();
+        CASE(OP_LESS_EQUAL):     less_equal: COMPARISON_OP(<=); DISPATCH();
+        CASE(OP_GREATER):        greater: COMPARISON_OP(>); DISPATCH();
+        CASE(OP_GREATER_EQUAL):  greater_equal: COMPARISON_OP(>=); DISPATCH();
+        CASE(OP_ADD):
+        add: {
+            if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+                INT_BINARY_OP(+, __builtin_add_overflow);
+            } else if (IS_STRING(PEEK(0)) && IS_STRING(PEEK(1))) {
+                SYNC();
+                if (!concatenate()) {
+                    runtime_error("Out of memory.");
                     return INTERPRET_RUNTIME_ERROR;
                 }
-                break;
+                sp = vm->stack + vm->stack_count;
+            } else if (IS_NUMERIC(PEEK(0)) && IS_NUMERIC(PEEK(1))) {
+                BINARY_OP(NUMBER_VAL, +);
+            } else {
+                RUNTIME_ERROR("Operands must be two numbers or two strings.");
             }
+            DISPATCH();
+        }
 
-            case OP_SUBTRACT:       BINARY_OP(NUMBER_VAL, -); break;
-            case OP_MULTIPLY:       BINARY_OP(NUMBER_VAL, *); break;
-            case OP_DIVIDE:         BINARY_OP(NUMBER_VAL, /); break;
-            case OP_NOT: {
-                hdb_value_t *v = &vm->stack[vm->stack_count] - 1;
+        CASE(OP_SUBTRACT):       subtract: ARITHMETIC_OP(-, __builtin_sub_overflow); DISPATCH();
+        CASE(OP_MULTIPLY):       multiply: ARITHMETIC_OP(*, __builtin_mul_overflow); DISPATCH();
+        CASE(OP_DIVIDE):
+        divide: {
+            if (IS_NUMERIC(PEEK(0)) && AS_DOUBLE(PEEK(0)) == 0.0) {
+                RUNTIME_ERROR("Division by zero.");
+            }
 
-                if (!IS_BOOL(*v)) {
-                    runtime_error("Operand must be a boolean value.");
-                    return INTERPRET_RUNTIME_ERROR;
+            if (IS_INT(PEEK(0)) && IS_INT(PEEK(1))) {
+                // Integer division truncates, like SQL does. Only HDB_INT_MIN / -1 leaves the integer range.
+                int64_t right = AS_INT(POP());
+                int64_t left  = AS_INT(POP());
+                if (left == HDB_INT_MIN && right == -1) {
+                    PUSH(NUMBER_VAL(-(double)left));
+                } else {
+                    PUSH(INT_VAL(left / right));
                 }
+            } else {
+                BINARY_OP(NUMBER_VAL, /);
+            }
+            DISPATCH();
+        }
+        CASE(OP_NOT): {
+            hdb_value_t *v = sp - 1;
 
-                // Update in-place
-                v->as.boolean = !v->as.boolean;
-                break;
+            if (!IS_BOOL(*v)) {
+                RUNTIME_ERROR("Operand must be a boolean value.");
             }
 
-            case OP_NEGATE: {
-                if (!IS_NUMBER(stack_peek(0))) {
-                    runtime_error("Operand must be a number.");
-                    return INTERPRET_RUNTIME_ERROR;
-                }
+            // Update in-place
+            *v = BOOL_VAL(!AS_BOOL(*v));
+            DISPATCH();
+        }
 
-                // Update in-place
-                hdb_value_t *v = &vm->stack[vm->stack_count] - 1;
-                v->as.number = -v->as.number;
+        CASE(OP_NEGATE): {
+            if (!IS_NUMERIC(PEEK(0))) {
+                RUNTIME_ERROR("Operand must be a number.");
             }
-            break;
-            case OP_RETURN:
-#ifdef DEBUG_TRACE_EXECUTION
-                hdb_dbg_print_value(hdb_vm_stack_pop());
-                printf("\n");
-#else
-                hdb_vm_stack_pop();
-#endif
-                return INTERPRET_OK;
+
+            // Update in-place
+            hdb_value_t *v = sp - 1;
+            if (!IS_INT(*v)) {
+                *v = NUMBER_VAL(-AS_NUMBER(*v));
+            } else if (AS_INT(*v) == HDB_INT_MIN) {
+                *v = NUMBER_VAL(-(double)AS_INT(*v));
+            } else {
+                *v = INT_VAL(-AS_INT(*v));
+            }
+            DISPATCH();
+        }
+
+        // Superinstructions push their constant and continue with the plain instruction, saving a dispatch.
+        CASE(OP_ADD_CONSTANT):            PUSH(READ_SHORT_CONSTANT()); goto add;
+        CASE(OP_SUBTRACT_CONSTANT):       PUSH(READ_SHORT_CONSTANT()); goto subtract;
+        CASE(OP_MULTIPLY_CONSTANT):       PUSH(READ_SHORT_CONSTANT()); goto multiply;
+        CASE(OP_DIVIDE_CONSTANT):         PUSH(READ_SHORT_CONSTANT()); goto divide;
+        CASE(OP_EQUAL_CONSTANT):          PUSH(READ_SHORT_CONSTANT()); goto equal;
+        CASE(OP_NOT_EQUAL_CONSTANT):      PUSH(READ_SHORT_CONSTANT()); goto not_equal;
+        CASE(OP_GREATER_CONSTANT):        PUSH(READ_SHORT_CONSTANT()); goto greater;
+        CASE(OP_GREATER_EQUAL_CONSTANT):  PUSH(READ_SHORT_CONSTANT()); goto greater_equal;
+        CASE(OP_LESS_CONSTANT):           PUSH(READ_SHORT_CONSTANT()); goto less;
+        CASE(OP_LESS_EQUAL_CONSTANT):     PUSH(READ_SHORT_CONSTANT()); goto less_equal;
+
+        // Values that cannot be ordered compare false both ways, so a negated comparison is not the opposite one.
+        CASE(OP_NOT_GREATER):        COMPARISON_OP(>); sp[-1] = BOOL_VAL(!AS_BOOL(sp[-1])); DISPATCH();
+        CASE(OP_NOT_GREATER_EQUAL):  COMPARISON_OP(>=); sp[-1] = BOOL_VAL(!AS_BOOL(sp[-1])); DISPATCH();
+        CASE(OP_NOT_LESS):           COMPARISON_OP(<); sp[-1] = BOOL_VAL(!AS_BOOL(sp[-1])); DISPATCH();
+        CASE(OP_NOT_LESS_EQUAL):     COMPARISON_OP(<=); sp[-1] = BOOL_VAL(!AS_BOOL(sp[-1])); DISPATCH();
+
+        CASE(OP_PARAMETER): {
+            const uint8_t index = READ_BYTE();
+            PUSH(index < vm->parameter_count ? vm->parameters[index] : NULL_VAL);
+            DISPATCH();
+        }
+
+        CASE(OP_RETURN): {
+            // The result stays just above the top of the stack, where the caller can read it.
+            (void)POP();
+            SYNC();
+
+            return INTERPRET_OK;
         }
     }
 
+#ifdef HDB_VM_COMPUTED_GOTO
+trace:
+    ip--;
+    SYNC();
+    trace_instruction();
+    goto *dispatch_table[READ_BYTE()];
+#else
+    // An unknown opcode is skipped, like the switch without a default case always did.
+    DISPATCH();
+#endif
+
 #undef READ_BYTE
-#undef READ_CONSTANT
+#undef READ_SHORT_CONSTANT
+#undef READ_LONG_CONSTANT
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef SYNC
+#undef RUNTIME_ERROR
 #undef BINARY_OP
+#undef INT_BINARY_OP
+#undef ARITHMETIC_OP
+#undef COMPARISON_OP
+#undef DISPATCH_LOOP
+#undef CASE
+#undef DISPATCH
+}
+
+void hdb_vm_trace(bool enabled) {
+    vm->trace = enabled;
 }
 
 // Increase stack size if required
@@ -246,20 +464,63 @@ static void ensure_stack_size(hdb_chunk_t chunk) {
     stack_grow(factor);
 }
 
-hdb_interpret_result_t hdb_vm_interpret(const char* source) {
-    hdb_chunk_t chunk;
-    hdb_chunk_init(&chunk);
+hdb_interpret_result_t hdb_vm_execute(hdb_chunk_t* chunk, const hdb_value_t* parameters, int32_t parameter_count) {
+    vm->chunk = chunk;
+    vm->ip = chunk->code;
+    vm->parameters = parameters;
+    vm->parameter_count = parameters ? parameter_count : 0;
+
+    ensure_stack_size(*chunk);
+    return run();
+}
+
+bool hdb_vm_compile(const char* source, hdb_chunk_t* chunk) {
+    const hdb_chunk_t* cached = hdb_statement_cache_lookup(&vm->statement_cache, source);
+    if (cached) {
+        // Copying allocates, so keep the cache from evicting the statement under memory pressure meanwhile.
+        hdb_statement_cache_pin(&vm->statement_cache, cached);
+        const bool result = hdb_chunk_copy(chunk, cached);
+        hdb_statement_cache_pin(&vm->statement_cache, NULL);
+        return result;
+    }
 
-    if (!hdb_compiler_compile(source, &chunk)) {
-        return INTERPRET_COMPILE_ERROR;
+    hdb_chunk_t compiled;
+    hdb_chunk_init_arena(&compiled, &vm->chunk_arena);
+
+    bool result = false;
+    if (hdb_compiler_compile(source, &compiled)) {
+        hdb_statement_cache_insert(&vm->statement_cache, &compiled);
+        result = hdb_chunk_copy(chunk, &compiled);
+    } else {
+        hdb_chunk_init(chunk);
     }
 
-    vm->chunk = &chunk;
-    vm->ip = vm->chunk->code;
+    hdb_chunk_free(&compiled);
+    hdb_arena_reset(&vm->chunk_arena);
+    return result;
+}
 
-    ensure_stack_size(chunk);
-    hdb_interpret_result_t result = run();
+hdb_interpret_result_t hdb_vm_interpret(const char* source) {
+    hdb_chunk_t* cached = hdb_statement_cache_lookup(&vm->statement_cache, source);
+    if (cached) {
+        hdb_statement_cache_pin(&vm->statement_cache, cached);
+        const hdb_interpret_result_t result = hdb_vm_execute(cached, NULL, 0);
+        hdb_statement_cache_pin(&vm->statement_cache, NULL);
+        return result;
+    }
+
+    hdb_chunk_t chunk;
+    hdb_chunk_init_arena(&chunk, &vm->chunk_arena);
+
+    hdb_interpret_result_t result = INTERPRET_COMPILE_ERROR;
+    if (hdb_compiler_compile(source, &chunk)) {
+        // The statement is executed from the arena, so the cache is free to evict its copy meanwhile.
+        hdb_statement_cache_insert(&vm->statement_cache, &chunk);
+        result = hdb_vm_execute(&chunk, NULL, 0);
+    }
 
+    // Release everything the chunk claimed at once.
     hdb_chunk_free(&chunk);
+    hdb_arena_reset(&vm->chunk_arena);
     return result;
 }
\ No newline at end of file
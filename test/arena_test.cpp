@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <memory.h>
+#include <arena.h>
+#include <chunk.h>
+}
+
+class HdbArenaFixture : public ::testing::Test {
+protected:
+    hdb_heap_view_t* heap;
+    hdb_arena_t arena;
+
+    virtual void SetUp() {
+        heap = hdb_heap_init(256, 2048);
+        hdb_arena_init(&arena);
+    }
+
+    virtual void TearDown() {
+        hdb_arena_free(&arena);
+        hdb_heap_free();
+    }
+};
+
+TEST_F(HdbArenaFixture, hdb_arena_allocate_zero_bytes) {
+    EXPECT_EQ(hdb_arena_allocate(&arena, 0), nullptr);
+    EXPECT_EQ(arena.pages, nullptr);
+}
+
+TEST_F(HdbArenaFixture, hdb_arena_allocate_bumps_pointer) {
+    auto first = static_cast<char*>(hdb_arena_allocate(&arena, 20));
+    auto second = static_cast<char*>(hdb_arena_allocate(&arena, 8));
+
+    EXPECT_EQ((uintptr_t)first % HDB_ARENA_ALIGNMENT, 0);
+    EXPECT_EQ(second - first, 32);
+    EXPECT_EQ(arena.pages->next, nullptr);
+}
+
+TEST_F(HdbArenaFixture, hdb_arena_reallocate_last_in_place) {
+    auto first = static_cast<char*>(hdb_arena_allocate(&arena, 8));
+    memset(first, 0x2a, 8);
+
+    EXPECT_EQ(hdb_arena_reallocate(&arena, first, 8, 64), first);
+
+    // Another allocation follows, so the first one can no longer grow in place.
+    hdb_arena_allocate(&arena, 8);
+    auto moved = static_cast<char*>(hdb_arena_reallocate(&arena, first, 64, 128));
+    EXPECT_NE(moved, first);
+    EXPECT_EQ(moved[7], 0x2a);
+}
+
+TEST_F(HdbArenaFixture, hdb_arena_grows_with_larger_pages) {
+    hdb_arena_allocate(&arena, 1024);
+    hdb_arena_allocate(&arena, 4096);
+
+    ASSERT_NE(arena.pages->next, nullptr);
+    EXPECT_GT(arena.pages->size, arena.pages->next->size);
+}
+
+TEST_F(HdbArenaFixture, hdb_arena_reset_keeps_largest_page) {
+    hdb_arena_allocate(&arena, 1024);
+    void* large = hdb_arena_allocate(&arena, 4096);
+    hdb_arena_page_t* largest = arena.pages;
+    const size_t free_before = heap->current_free;
+
+    hdb_arena_reset(&arena);
+    EXPECT_EQ(arena.pages, largest);
+    EXPECT_EQ(arena.pages->next, nullptr);
+    EXPECT_GT(heap->current_free, free_before);
+
+    // The next cycle reuses the kept page without claiming memory from the heap.
+    const size_t free_after = heap->current_free;
+    EXPECT_EQ(hdb_arena_allocate(&arena, 4096), large);
+    EXPECT_EQ(heap->current_free, free_after);
+}
+
+TEST_F(HdbArenaFixture, hdb_chunk_allocates_from_arena) {
+    hdb_chunk_t chunk;
+    hdb_chunk_init_arena(&chunk, &arena);
+
+    const size_t free_before = heap->current_free;
+    for (int i = 0; i < 100; i++) {
+        hdb_chunk_write(&chunk, OP_RETURN, i);
+        hdb_chunk_write_constant(&chunk, NUMBER_VAL((double)i), i);
+    }
+
+    EXPECT_NE(arena.pages, nullptr);
+    EXPECT_EQ(chunk.constants.count, 100);
+
+    hdb_chunk_free(&chunk);
+    EXPECT_EQ(chunk.arena, &arena);
+    EXPECT_EQ(chunk.constants.arena, &arena);
+
+    // Resetting the arena returns all but a single page to the heap.
+    hdb_arena_reset(&arena);
+    EXPECT_EQ(arena.pages->next, nullptr);
+    EXPECT_EQ(heap->current_free, free_before - (arena.pages->size + sizeof(hdb_arena_page_t) + HDB_HEAP_PAGE_SIZE));
+}
@@ -49,10 +49,66 @@ TEST_F(HdbChunkFixture, write_large_constant) {
         hdb_chunk_write_constant(chunk, NUMBER_VAL(1.23), i + 1);
     }
 
+    // Identical constants share a single index.
+    EXPECT_EQ(chunk->count, 514);
+    EXPECT_EQ(chunk->constants.count, 1);
+    EXPECT_EQ(AS_NUMBER(chunk->constants.values[0]), 1.23);
+    EXPECT_EQ(chunk->code[512], OP_CONSTANT);
+    EXPECT_EQ(chunk->code[513], 0);
+}
+
+TEST_F(HdbChunkFixture, write_distinct_large_constants) {
+    for (int i = 0; i < 257; i++) {
+        hdb_chunk_write_constant(chunk, NUMBER_VAL(i + 0.5), i + 1);
+    }
+
     EXPECT_EQ(chunk->count, 516);
     EXPECT_EQ(chunk->constants.count, 257);
-    EXPECT_EQ(AS_NUMBER(chunk->constants.values[0]), 1.23);
-    EXPECT_EQ(AS_NUMBER(chunk->constants.values[256]), 1.23);
+    EXPECT_EQ(AS_NUMBER(chunk->constants.values[0]), 0.5);
+    EXPECT_EQ(AS_NUMBER(chunk->constants.values[256]), 256.5);
+    EXPECT_EQ(chunk->code[512], OP_CONSTANT_LONG);
+    EXPECT_EQ(AS_NUMBER(hdb_chunk_read_constant(chunk, chunk->code + 1)), 0.5);
+    EXPECT_EQ(AS_NUMBER(hdb_chunk_read_constant(chunk, chunk->code + 513)), 256.5);
+}
+
+TEST_F(HdbChunkFixture, constants_are_interned_by_type_and_bits) {
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(1)), 0);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NUMBER_VAL(1.0)), 1);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NUMBER_VAL(0.0)), 2);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NUMBER_VAL(-0.0)), 3);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, BOOL_VAL(true)), 4);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NULL_VAL), 5);
+
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NUMBER_VAL(-0.0)), 3);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(1)), 0);
+    EXPECT_EQ(hdb_chunk_find_constant(chunk, BOOL_VAL(false)), -1);
+    EXPECT_EQ(chunk->constants.count, 6);
+}
 
+TEST_F(HdbChunkFixture, dropped_constants_are_not_found) {
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(7)), 0);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(8)), 1);
+
+    chunk->constants.count = 1;
+    EXPECT_EQ(hdb_chunk_find_constant(chunk, INT_VAL(8)), -1);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(9)), 1);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(8)), 2);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(7)), 0);
 }
 
+TEST_F(HdbChunkFixture, copy_keeps_interning_constants) {
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, INT_VAL(7)), 0);
+    EXPECT_EQ(hdb_chunk_add_constant(chunk, NUMBER_VAL(1.5)), 1);
+
+    hdb_chunk_t copy;
+    ASSERT_TRUE(hdb_chunk_copy(&copy, chunk));
+    EXPECT_EQ(hdb_chunk_find_constant(&copy, NUMBER_VAL(1.5)), 1);
+    EXPECT_EQ(hdb_chunk_add_constant(&copy, INT_VAL(7)), 0);
+    EXPECT_EQ(hdb_chunk_add_constant(&copy, INT_VAL(8)), 2);
+    EXPECT_EQ(hdb_chunk_add_constant(&copy, INT_VAL(8)), 2);
+    EXPECT_EQ(copy.constants.count, 3);
+
+    // The copy has its own slots.
+    EXPECT_EQ(hdb_chunk_find_constant(chunk, INT_VAL(8)), -1);
+    hdb_chunk_free(&copy);
+}
@@ -0,0 +1,157 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+    #include <vm.h>
+    #include <chunk.h>
+    #include <compiler.h>
+    #include <ustring.h>
+}
+
+class HdbCompilerFixture : public ::testing::Test {
+protected:
+    hdb_chunk_t chunk;
+
+    virtual void SetUp() {
+        hdb_vm_init(256, 512);
+        hdb_chunk_init(&chunk);
+    }
+
+    virtual void TearDown() {
+        hdb_chunk_free(&chunk);
+        hdb_vm_free();
+    }
+
+    std::vector<uint8_t> compile(const char* source) {
+        EXPECT_TRUE(hdb_compiler_compile(source, &chunk));
+        return std::vector<uint8_t>(chunk.code, chunk.code + chunk.count);
+    }
+};
+
+TEST_F(HdbCompilerFixture, constant_operand_superinstruction) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_ADD_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("true + 4"), expected);
+    EXPECT_EQ(AS_INT(chunk.constants.values[0]), 4);
+}
+
+TEST_F(HdbCompilerFixture, small_integer_operand_superinstruction) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_SUBTRACT_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("true - 1"), expected);
+    EXPECT_EQ(AS_INT(chunk.constants.values[0]), 1);
+}
+
+TEST_F(HdbCompilerFixture, compare_with_constant_superinstruction) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_MULTIPLY_CONSTANT, 0, OP_GREATER_CONSTANT, 1, OP_RETURN};
+    EXPECT_EQ(compile("true * 4.5 > 10"), expected);
+}
+
+TEST_F(HdbCompilerFixture, non_constant_operand_keeps_plain_instruction) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_TRUE, OP_MULTIPLY_CONSTANT, 1, OP_ADD, OP_RETURN};
+    EXPECT_EQ(compile("3 + true * 5"), expected);
+}
+
+TEST_F(HdbCompilerFixture, negated_comparison) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_TRUE, OP_MULTIPLY_CONSTANT, 1, OP_NOT_LESS_EQUAL, OP_RETURN};
+    EXPECT_EQ(compile("!(3 <= true * 5)"), expected);
+}
+
+TEST_F(HdbCompilerFixture, negated_equality) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_MULTIPLY_CONSTANT, 0, OP_NOT_EQUAL_CONSTANT, 1, OP_RETURN};
+    EXPECT_EQ(compile("!(true * 3 = 4)"), expected);
+}
+
+TEST_F(HdbCompilerFixture, double_negation_restores_comparison) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_TRUE, OP_MULTIPLY_CONSTANT, 1, OP_GREATER, OP_RETURN};
+    EXPECT_EQ(compile("!!(3 > true * 5)"), expected);
+}
+
+TEST_F(HdbCompilerFixture, identical_constants_share_index) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_MULTIPLY_CONSTANT, 0, OP_ADD_CONSTANT, 0, OP_GREATER_CONSTANT, 1,
+                                     OP_RETURN};
+    EXPECT_EQ(compile("true * 'x' + 'x' > 2"), expected);
+    EXPECT_EQ(chunk.constants.count, 2);
+}
+
+TEST_F(HdbCompilerFixture, fold_arithmetic) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("(1 + 2) * 3 - -4"), expected);
+    EXPECT_EQ(chunk.constants.count, 1);
+    EXPECT_TRUE(IS_INT(chunk.constants.values[0]));
+    EXPECT_EQ(AS_INT(chunk.constants.values[0]), 13);
+}
+
+TEST_F(HdbCompilerFixture, fold_to_small_integer) {
+    std::vector<uint8_t> expected = {OP_MINUS_ONE, OP_RETURN};
+    EXPECT_EQ(compile("4 / -3"), expected);
+    EXPECT_EQ(chunk.constants.count, 0);
+}
+
+TEST_F(HdbCompilerFixture, fold_respects_double_semantics) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("0.1 + 0.2"), expected);
+    EXPECT_EQ(AS_NUMBER(chunk.constants.values[0]), 0.1 + 0.2);
+
+    hdb_chunk_free(&chunk);
+    expected = {OP_FALSE, OP_RETURN};
+    EXPECT_EQ(compile("0.1 + 0.2 = 0.3"), expected);
+
+    hdb_chunk_free(&chunk);
+    expected = {OP_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("7 / 2.0"), expected);
+    EXPECT_EQ(AS_NUMBER(chunk.constants.values[0]), 3.5);
+}
+
+TEST_F(HdbCompilerFixture, fold_string_concatenation) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("'a' + 'b' + 'c'"), expected);
+    EXPECT_EQ(chunk.constants.count, 1);
+
+    hdb_value_t abc = OBJ_VAL(hdb_ustring_create("abc"));
+    EXPECT_TRUE(hdb_values_equal(chunk.constants.values[0], abc));
+}
+
+TEST_F(HdbCompilerFixture, fold_comparison) {
+    std::vector<uint8_t> expected = {OP_TRUE, OP_RETURN};
+    EXPECT_EQ(compile("!(3 > 4 * 5)"), expected);
+
+    hdb_chunk_free(&chunk);
+    expected = {OP_FALSE, OP_RETURN};
+    EXPECT_EQ(compile("'a' <> 'a'"), expected);
+}
+
+TEST_F(HdbCompilerFixture, fold_keeps_runtime_errors) {
+    std::vector<uint8_t> expected = {OP_ONE, OP_DIVIDE_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("1 / (2 - 2)"), expected);
+
+    hdb_chunk_free(&chunk);
+    expected = {OP_CONSTANT, 0, OP_NEGATE, OP_RETURN};
+    EXPECT_EQ(compile("-'a'"), expected);
+
+    hdb_chunk_free(&chunk);
+    expected = {OP_CONSTANT, 0, OP_LESS_CONSTANT, 1, OP_RETURN};
+    EXPECT_EQ(compile("'a' < 'b'"), expected);
+}
+
+TEST_F(HdbCompilerFixture, fold_keeps_line) {
+    std::vector<uint8_t> expected = {OP_CONSTANT, 0, OP_RETURN};
+    EXPECT_EQ(compile("1 + 2\n * 3\n"), expected);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 0), 1);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 1), 1);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 2), 3);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 3), -1);
+}
+
+TEST_F(HdbCompilerFixture, parameters) {
+    std::vector<uint8_t> expected = {OP_PARAMETER, 0, OP_PARAMETER, 1, OP_MULTIPLY_CONSTANT, 0, OP_ADD,
+                                     OP_PARAMETER, 1, OP_SUBTRACT, OP_RETURN};
+    EXPECT_EQ(compile("? + :a * 2 - :a"), expected);
+
+    EXPECT_EQ(chunk.parameters.count, 2);
+    EXPECT_TRUE(IS_NULL(chunk.parameters.values[0]));
+    EXPECT_TRUE(hdb_values_equal(chunk.parameters.values[1], OBJ_VAL(hdb_ustring_create("a"))));
+}
+
+TEST_F(HdbCompilerFixture, parameter_without_name) {
+    EXPECT_FALSE(hdb_compiler_compile(":1", &chunk));
+}
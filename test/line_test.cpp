@@ -132,4 +132,28 @@ TEST_F(HdbLineArrayFixture, decode_existing_index) {
     EXPECT_EQ(hdb_line_decode(lines, 2), 2);
     EXPECT_EQ(hdb_line_decode(lines, 3), 3);
     EXPECT_EQ(hdb_line_decode(lines, 4), 5);
-}
\ No newline at end of file
+}
+
+TEST_F(HdbLineArrayFixture, truncate_within_line) {
+    hdb_line_encode(lines, 1);
+    hdb_line_encode(lines, 2);
+    hdb_line_encode(lines, 2);
+    hdb_line_encode(lines, 3);
+
+    hdb_line_truncate(lines, 2);
+    EXPECT_EQ(lines->count, 2);
+    EXPECT_EQ(hdb_line_decode(lines, 1), 2);
+    EXPECT_EQ(hdb_line_decode(lines, 2), -1);
+
+    hdb_line_encode(lines, 4);
+    EXPECT_EQ(hdb_line_decode(lines, 2), 4);
+}
+
+TEST_F(HdbLineArrayFixture, truncate_all) {
+    hdb_line_encode(lines, 1);
+    hdb_line_encode(lines, 2);
+
+    hdb_line_truncate(lines, 0);
+    EXPECT_EQ(lines->count, 0);
+    EXPECT_EQ(hdb_line_decode(lines, 0), -1);
+}
@@ -1,3 +1,16 @@
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 #include "gtest/gtest.h"
 
 extern "C" {
@@ -67,7 +80,7 @@ TEST_F(HdbMemoryFixture, hdb_malloc_max) {
 
     EXPECT_EQ(block->size, heap->current_size);
     EXPECT_EQ(heap->current_free, 0);
-    EXPECT_EQ(heap->free_blocks, nullptr);
+    EXPECT_EQ(heap->free_classes, 0);
 
     size_t expected = block->size;
     hdb_free(ptr);
@@ -128,22 +141,553 @@ TEST_F(HdbMemoryFixture, hdb_malloc_free_block_fragmentation) {
     }
     EXPECT_EQ(heap->current_size, heap->current_free);
 
-    // There should be 'max' blocks of 32 bytes, which is the amount of bytes that must be allocated when
-    // the user requests one byte of memory. The remaining block must fill the rest of the free space.
-    hdb_memory_block_view_t* current_block = heap->free_blocks;
-    for (int i = 0; i < max; i++) {
-        EXPECT_EQ(current_block->size, 32);
+    // Every freed block is merged with its free neighbours right away, so the contiguous space ends up
+    // in a single free block again.
+    EXPECT_EQ(__builtin_popcountll(heap->free_classes), 1);
+
+    hdb_memory_block_view_t* block = heap->free_lists[__builtin_ctzll(heap->free_classes)];
+    EXPECT_NE(block, nullptr);
+    EXPECT_EQ(block->next, nullptr);
+    EXPECT_EQ(HDB_BLOCK_SIZE(block), heap->current_free);
+}
+
+TEST_F(HdbMemoryFixture, hdb_free_merges_with_neighbours) {
+    void* left = hdb_malloc(1);
+    void* middle = hdb_malloc(1);
+    void* right = hdb_malloc(1);
+    void* guard = hdb_malloc(1);
+
+    hdb_free(left);
+    hdb_free(right);
+    EXPECT_NE(heap->free_lists[5], nullptr);
+
+    // Freeing the middle block merges it with both neighbours into a single block of 96 bytes.
+    hdb_free(middle);
+    EXPECT_EQ(heap->free_lists[5], nullptr);
+    EXPECT_NE(heap->free_lists[6], nullptr);
+    EXPECT_EQ(HDB_BLOCK_SIZE(heap->free_lists[6]), 96);
+    auto block = HDB_CPP_BLOCK_PTR(left);
+    EXPECT_EQ(heap->free_lists[6], (hdb_memory_block_view_t*)block);
+
+    hdb_free(guard);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+    EXPECT_EQ(__builtin_popcountll(heap->free_classes), 1);
+}
+
+TEST_F(HdbMemoryFixture, hdb_free_files_block_under_size_class) {
+    void* ptr = hdb_malloc(100);
+    auto block = HDB_CPP_BLOCK_PTR(ptr);
+    EXPECT_EQ(block->size, 128);
+
+    // Keep the freed block from being merged with the rest of the heap.
+    void* guard = hdb_malloc(1);
+
+    hdb_free(ptr);
+    EXPECT_EQ(heap->free_lists[7], (hdb_memory_block_view_t*)block);
+    EXPECT_NE(heap->free_classes & (1ull << 7), 0);
+
+    // The freed block is reused right away for a request of the same size class.
+    EXPECT_EQ(hdb_malloc(100), ptr);
+    EXPECT_EQ(heap->free_classes & (1ull << 7), 0);
+    hdb_free(ptr);
+    hdb_free(guard);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_grows_heap_with_arena) {
+    hdb_heap_free();
+    heap = hdb_heap_init(256, (size_t)1 << 40);
+    const size_t initial_size = heap->current_size;
+
+    // Claim the complete initial arena, so the next allocation requires a new one.
+    void* initial = hdb_malloc(heap->current_free - HDB_HEAP_PAGE_SIZE);
+    EXPECT_EQ(heap->current_free, 0);
+
+    void* grown = hdb_malloc(1);
+    EXPECT_NE(grown, nullptr);
+    EXPECT_EQ(heap->current_size, initial_size + HDB_HEAP_INCREASE_SIZE);
+
+    // The new arena is kept while it is the only free memory in the heap.
+    hdb_free(grown);
+    EXPECT_EQ(heap->current_size, initial_size + HDB_HEAP_INCREASE_SIZE);
+    EXPECT_EQ(heap->current_free, HDB_HEAP_INCREASE_SIZE);
+
+    hdb_free(initial);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_free_returns_idle_arena) {
+    hdb_heap_free();
+    heap = hdb_heap_init(256, (size_t)1 << 40);
+    const size_t initial_size = heap->current_size;
+
+    // A request larger than the initial arena grows the heap with an arena that fits it.
+    void* large = hdb_malloc(initial_size);
+    EXPECT_NE(large, nullptr);
+    EXPECT_EQ(heap->current_size, initial_size + initial_size * 2);
+    EXPECT_EQ(heap->current_free, initial_size);
+
+    // Once the grown arena is idle, it is unmapped, since the initial arena still has plenty of free memory.
+    hdb_free(large);
+    EXPECT_EQ(heap->current_size, initial_size);
+    EXPECT_EQ(heap->current_free, initial_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_reallocate_grows_in_place) {
+    void* ptr = hdb_malloc(1);
+    memset(ptr, 0x2a, 8);
+
+    // The block is followed by the rest of the free heap, so it can grow without moving.
+    void* grown = hdb_reallocate(ptr, 1000);
+    auto block = HDB_CPP_BLOCK_PTR(grown);
+    EXPECT_EQ(grown, ptr);
+    EXPECT_EQ(HDB_BLOCK_SIZE(block), 1024);
+    EXPECT_EQ(heap->current_free, heap->current_size - 1024);
+    EXPECT_EQ(static_cast<char*>(grown)[7], 0x2a);
+
+    hdb_free(grown);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_reallocate_moves_and_frees) {
+    void* ptr = hdb_malloc(1);
+    void* guard = hdb_malloc(1);
+    memset(ptr, 0x2a, 8);
+
+    // The next block is in use, so the data must move. The old block is released.
+    void* moved = hdb_reallocate(ptr, 100);
+    EXPECT_NE(moved, ptr);
+    EXPECT_EQ(static_cast<char*>(moved)[7], 0x2a);
+    EXPECT_EQ(heap->current_free, heap->current_size - 32 - 128);
+
+    hdb_free(moved);
+    hdb_free(guard);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_thread_cache_serves_small_blocks) {
+    hdb_heap_cache_t* cache = hdb_heap_thread_attach();
+    ASSERT_NE(cache, nullptr);
+    EXPECT_EQ(hdb_heap_thread_attach(), cache);
+
+    // The first allocation refills the cache with a whole batch of 32 byte blocks.
+    void* first = hdb_malloc(1);
+    EXPECT_EQ(cache->counts[5], HDB_HEAP_CACHE_BATCH - 1);
+    EXPECT_EQ(heap->current_free, heap->current_size - 32 * HDB_HEAP_CACHE_BATCH);
+
+    // Freeing keeps the block in the cache, without returning it to the heap.
+    hdb_free(first);
+    EXPECT_EQ(cache->counts[5], HDB_HEAP_CACHE_BATCH);
+    EXPECT_EQ(hdb_malloc(1), first);
+    hdb_free(first);
+
+    // Detaching flushes the cache, after which all cached blocks have merged again.
+    hdb_heap_thread_detach();
+    EXPECT_EQ(hdb_heap_thread_cache(), nullptr);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_thread_cache_flushes_when_full) {
+    hdb_heap_cache_t* cache = hdb_heap_thread_attach();
+    void* blocks[HDB_HEAP_CACHE_CAPACITY + 1];
+
+    for (auto & block : blocks) {
+        block = hdb_malloc(100);
+    }
+    for (auto & block : blocks) {
+        hdb_free(block);
+    }
+
+    // Three batches were taken, of which 15 blocks remained cached. Freeing all 33 blocks overflows the bin once,
+    // which flushes a single batch back to the heap.
+    EXPECT_EQ(cache->counts[7], 3 * HDB_HEAP_CACHE_BATCH - HDB_HEAP_CACHE_BATCH);
+    EXPECT_EQ(heap->current_free, heap->current_size - 128 * cache->counts[7]);
+
+    hdb_heap_thread_detach();
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_from_multiple_threads) {
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t]() {
+            // Every other thread shares the heap directly, the others use a thread cache.
+            if (t % 2) {
+                hdb_heap_thread_attach();
+            }
+
+            for (int round = 0; round < 100; round++) {
+                void* blocks[64];
+                for (int i = 0; i < 64; i++) {
+                    blocks[i] = hdb_malloc(8 + (size_t)(i * 67 + t) % 5000);
+                    memset(blocks[i], t, 8);
+                }
+                for (auto & block : blocks) {
+                    EXPECT_EQ(*static_cast<char*>(block), t);
+                    hdb_free(block);
+                }
+            }
+
+            hdb_heap_thread_detach();
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
 
-        current_block = current_block->next;
+TEST_F(HdbMemoryFixture, hdb_heap_stress_from_attached_threads) {
+    hdb_heap_free();
+    heap = hdb_heap_init(256, (size_t)1 << 30);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([t]() {
+            hdb_heap_thread_attach();
+            std::mt19937 random(t);
+
+            // Mix cached and uncached sizes, so the threads split and merge neighbouring blocks concurrently.
+            for (int round = 0; round < 200; round++) {
+                char* blocks[64];
+                size_t sizes[64];
+                for (int i = 0; i < 64; i++) {
+                    sizes[i] = 1 + random() % (i % 4 ? 4000 : 40000);
+                    blocks[i] = static_cast<char*>(hdb_malloc(sizes[i]));
+                    ASSERT_NE(blocks[i], nullptr);
+                    memset(blocks[i], t, sizes[i]);
+                }
+                for (int i = 0; i < 64; i += 3) {
+                    blocks[i] = static_cast<char*>(hdb_reallocate(blocks[i], sizes[i] * 2));
+                    ASSERT_NE(blocks[i], nullptr);
+                    memset(blocks[i] + sizes[i], t, sizes[i]);
+                    sizes[i] *= 2;
+                }
+                for (int i = 0; i < 64; i++) {
+                    char* block = blocks[(i * 37) % 64];
+                    const size_t size = sizes[(i * 37) % 64];
+                    EXPECT_EQ(block[0], t);
+                    EXPECT_EQ(block[size - 1], t);
+                    hdb_free(block);
+                }
+            }
+
+            hdb_heap_thread_detach();
+        });
+    }
+
+    for (auto & thread : threads) {
+        thread.join();
     }
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
 
-    EXPECT_EQ(current_block->size, heap->current_size - (max * 32));
-    EXPECT_EQ(current_block->next, nullptr);
+TEST_F(HdbMemoryFixture, hdb_heap_commits_arena_on_demand) {
+    auto arena = reinterpret_cast<hdb_heap_t*>(heap)->arenas;
 
-    // hdb_heap_compact should merge all blocks in a single block, since the space is contiguous.
-    hdb_heap_compact();
-    EXPECT_NE(heap->free_blocks, nullptr);
-    EXPECT_EQ(heap->free_blocks->next, nullptr);
-    EXPECT_EQ(heap->free_blocks->size, heap->current_free);
+    // Only the first page and the pages at the end of the arena are committed up front.
+    EXPECT_LT(arena->committed, HDB_HEAP_COMMIT_SIZE);
+
+    void* ptr = hdb_malloc(HDB_HEAP_COMMIT_SIZE);
+    memset(ptr, 0x2a, HDB_HEAP_COMMIT_SIZE);
+    EXPECT_EQ(arena->committed, 3 * HDB_HEAP_COMMIT_SIZE);
+
+    // Blocks carved from already committed memory don't commit anything new.
+    void* small = hdb_malloc(1);
+    EXPECT_EQ(arena->committed, 3 * HDB_HEAP_COMMIT_SIZE);
+
+    hdb_free(small);
+    hdb_free(ptr);
     EXPECT_EQ(heap->current_free, heap->current_size);
-}
\ No newline at end of file
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_huge_pages_align_arenas) {
+    hdb_heap_free();
+    heap = hdb_heap_init_flags(256, 512, HDB_HEAP_HUGE_PAGES);
+    ASSERT_NE(heap, nullptr);
+
+    // Whether or not explicit huge pages are available, arenas are aligned to and sized in huge pages.
+    auto arena = reinterpret_cast<hdb_heap_t*>(heap)->arenas;
+    EXPECT_EQ((uintptr_t)((char*)arena - HDB_HEAP_PAGE_SIZE - arena->size) % HDB_HEAP_HUGE_PAGE_SIZE, 0);
+    EXPECT_EQ(arena->mapped_size % HDB_HEAP_HUGE_PAGE_SIZE, 0);
+
+    void* ptr = hdb_malloc(8192);
+    memset(ptr, 0x2a, 8192);
+    EXPECT_EQ(arena->committed % HDB_HEAP_HUGE_PAGE_SIZE, 0);
+
+    hdb_free(ptr);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+#ifdef __linux__
+/*
+ * Chases pointers through objects scattered over a large heap, and returns the amount of data TLB read misses
+ * of the calling thread while doing so, or -1 if those cannot be counted.
+ */
+static int64_t count_dtlb_misses(uint32_t flags) {
+    const size_t object_count = 1 << 20;
+
+    hdb_heap_free();
+    hdb_heap_init_flags((size_t)512 * 1024 * 1024, (size_t)512 * 1024 * 1024, flags);
+
+    // Allocate objects of 64 bytes which point to each other in random order.
+    std::vector<void**> objects(object_count);
+    for (auto & object : objects) {
+        object = static_cast<void**>(hdb_malloc(64));
+    }
+    std::vector<void**> order(objects);
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    for (size_t i = 0; i < object_count; i++) {
+        *order[i] = order[(i + 1) % object_count];
+    }
+
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+
+    void** current = order[0];
+    for (size_t i = 0; i < object_count * 4; i++) {
+        current = static_cast<void**>(*current);
+    }
+
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    int64_t misses = 0;
+    if (read(fd, &misses, sizeof(misses)) != sizeof(misses) || current == nullptr) {
+        misses = -1;
+    }
+    close(fd);
+
+    for (auto & object : objects) {
+        hdb_free(object);
+    }
+
+    return misses;
+}
+
+TEST_F(HdbMemoryFixture, DISABLED_hdb_heap_huge_pages_tlb_misses) {
+    const int64_t regular = count_dtlb_misses(HDB_HEAP_DEFAULT);
+    const int64_t huge = count_dtlb_misses(HDB_HEAP_HUGE_PAGES);
+
+    if (regular < 0 || huge < 0) {
+        GTEST_SKIP() << "dTLB misses cannot be counted on this system";
+    }
+
+    printf("dTLB read misses: %ld with regular pages, %ld with huge pages\n", (long)regular, (long)huge);
+    EXPECT_LT(huge, regular);
+}
+#endif
+
+TEST_F(HdbMemoryFixture, hdb_heap_stats_reports_usage) {
+    hdb_heap_stats_t stats;
+
+    void* small = hdb_malloc(1);
+    void* guard = hdb_malloc(100);
+    void* large = hdb_malloc(1000);
+    hdb_free(small);
+
+    ASSERT_TRUE(hdb_heap_stats(&stats));
+    EXPECT_EQ(stats.current_size, heap->current_size);
+    EXPECT_EQ(stats.current_free, heap->current_free);
+    EXPECT_EQ(stats.allocations[5], 1);
+    EXPECT_EQ(stats.allocations[7], 1);
+    EXPECT_EQ(stats.allocations[10], 1);
+    EXPECT_EQ(stats.peak_used, 32 + 128 + 1024);
+    EXPECT_EQ(stats.grow_events, 0);
+
+    // The freed block of 32 bytes is separated from the rest of the free memory by the guard.
+    EXPECT_EQ(stats.largest_free, heap->current_free - 32);
+    EXPECT_NEAR(stats.fragmentation, 32.0 / (double)heap->current_free, 1e-12);
+
+    hdb_free(guard);
+    hdb_free(large);
+
+    ASSERT_TRUE(hdb_heap_stats(&stats));
+    EXPECT_EQ(stats.largest_free, heap->current_size);
+    EXPECT_DOUBLE_EQ(stats.fragmentation, 0.0);
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_stats_counts_grow_events) {
+    hdb_heap_stats_t stats;
+    hdb_heap_free();
+    heap = hdb_heap_init(256, (size_t)1 << 40);
+
+    void* large = hdb_malloc(heap->current_size);
+    ASSERT_TRUE(hdb_heap_stats(&stats));
+    EXPECT_EQ(stats.grow_events, 1);
+    EXPECT_EQ(stats.peak_used, HDB_BLOCK_SIZE(HDB_CPP_BLOCK_PTR(large)));
+
+    hdb_free(large);
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_stats_counts_cached_allocations) {
+    hdb_heap_stats_t stats;
+    hdb_heap_thread_attach();
+
+    for (int i = 0; i < 3; i++) {
+        hdb_free(hdb_malloc(1));
+    }
+
+    // Allocations served by the cache are counted once the thread detaches.
+    hdb_heap_thread_detach();
+    ASSERT_TRUE(hdb_heap_stats(&stats));
+    EXPECT_EQ(stats.allocations[5], 3);
+}
+
+TEST_F(HdbMemoryFixture, hdb_heap_trace_records_operations) {
+    char path[] = "/tmp/hdb_trace_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+
+    ASSERT_TRUE(hdb_heap_trace_start(path));
+    void* ptr = hdb_malloc(10);
+    void* grown = hdb_reallocate(ptr, 100);
+    hdb_free(grown);
+    hdb_heap_trace_stop();
+
+    // Operations after the trace stopped are not recorded.
+    hdb_free(hdb_malloc(10));
+
+    hdb_heap_trace_record_t records[4];
+    FILE* file = fopen(path, "rb");
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(fread(records, sizeof(hdb_heap_trace_record_t), 4, file), 3);
+    fclose(file);
+    unlink(path);
+
+    EXPECT_EQ(records[0].operation, HDB_HEAP_TRACE_MALLOC);
+    EXPECT_EQ(records[0].address, (uint64_t)(uintptr_t)ptr);
+    EXPECT_EQ(records[0].size, 10);
+
+    EXPECT_EQ(records[1].operation, HDB_HEAP_TRACE_REALLOCATE);
+    EXPECT_EQ(records[1].address, (uint64_t)(uintptr_t)grown);
+    EXPECT_EQ(records[1].previous, (uint64_t)(uintptr_t)ptr);
+    EXPECT_EQ(records[1].size, 100);
+
+    EXPECT_EQ(records[2].operation, HDB_HEAP_TRACE_FREE);
+    EXPECT_EQ(records[2].address, (uint64_t)(uintptr_t)grown);
+    EXPECT_LE(records[0].timestamp, records[2].timestamp);
+}
+
+static std::vector<int> pressure_calls;
+
+static bool record_pressure(size_t size, void* context) {
+    pressure_calls.push_back(*static_cast<int*>(context));
+    return false;
+}
+
+static bool free_reserve(size_t size, void* context) {
+    pressure_calls.push_back(-1);
+
+    auto reserve = static_cast<void**>(context);
+    hdb_free(*reserve);
+    *reserve = nullptr;
+
+    return true;
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_runs_pressure_handlers_in_priority_order) {
+    int first = 1, second = 2, third = 3;
+    pressure_calls.clear();
+
+    ASSERT_TRUE(hdb_heap_pressure_register(record_pressure, &third, 10));
+    ASSERT_TRUE(hdb_heap_pressure_register(record_pressure, &first, -5));
+    ASSERT_TRUE(hdb_heap_pressure_register(record_pressure, &second, 0));
+
+    // None of the handlers returns memory, so the allocation fails after all of them ran.
+    errno = 0;
+    EXPECT_EQ(hdb_malloc(heap->current_size * 2), nullptr);
+    EXPECT_EQ(errno, ENOMEM);
+    EXPECT_EQ(pressure_calls, std::vector<int>({1, 2, 3}));
+
+    hdb_heap_pressure_unregister(record_pressure, &first);
+    hdb_heap_pressure_unregister(record_pressure, &second);
+    hdb_heap_pressure_unregister(record_pressure, &third);
+    EXPECT_EQ(reinterpret_cast<hdb_heap_t*>(heap)->pressure_handler_count, 0);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_retries_after_pressure_handler) {
+    int last = 1;
+    pressure_calls.clear();
+
+    void* reserve = hdb_malloc(heap->current_size / 2);
+    ASSERT_TRUE(hdb_heap_pressure_register(free_reserve, &reserve, 0));
+    ASSERT_TRUE(hdb_heap_pressure_register(record_pressure, &last, 1));
+
+    // Freeing the reserve makes room, so the handlers after it don't run.
+    void* ptr = hdb_malloc(heap->current_size / 2);
+    EXPECT_NE(ptr, nullptr);
+    EXPECT_EQ(reserve, nullptr);
+    EXPECT_EQ(pressure_calls, std::vector<int>({-1}));
+
+    hdb_free(ptr);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_aligned_returns_aligned_memory) {
+    void* guard = hdb_malloc(1);
+
+    for (size_t alignment = 16; alignment <= 4096; alignment *= 2) {
+        void* ptr = hdb_malloc_aligned(100, alignment);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_EQ((uintptr_t)ptr % alignment, 0);
+        memset(ptr, 0x2a, 100);
+
+        // Only the requested size is claimed, the padding in front and behind is returned to the heap.
+        auto block = HDB_CPP_BLOCK_PTR(ptr);
+        EXPECT_LT(HDB_BLOCK_SIZE(block), 100 + HDB_HEAP_PAGE_SIZE + 64);
+        EXPECT_EQ(heap->current_free, heap->current_size - 32 - HDB_BLOCK_SIZE(block));
+
+        hdb_free(ptr);
+        EXPECT_EQ(heap->current_free, heap->current_size - 32);
+    }
+
+    hdb_free(guard);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+    EXPECT_EQ(__builtin_popcountll(heap->free_classes), 1);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_aligned_grows_heap) {
+    hdb_heap_free();
+    heap = hdb_heap_init(256, (size_t)1 << 40);
+    hdb_heap_stats_t stats;
+
+    // The request exceeds the first arena, so the heap grows by a single arena of just the padded size, which is
+    // not a power of two.
+    const size_t size = heap->current_size;
+    void* ptr = hdb_malloc_aligned(size, 64);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ((uintptr_t)ptr % 64, 0);
+    static_cast<char*>(ptr)[0] = 0x2a;
+    static_cast<char*>(ptr)[size - 1] = 0x2a;
+
+    ASSERT_TRUE(hdb_heap_stats(&stats));
+    EXPECT_EQ(stats.grow_events, 1);
+
+    hdb_free(ptr);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
+
+TEST_F(HdbMemoryFixture, hdb_malloc_aligned_rejects_invalid_alignment) {
+    errno = 0;
+    EXPECT_EQ(hdb_malloc_aligned(100, 48), nullptr);
+    EXPECT_EQ(errno, EINVAL);
+
+    // Every block is aligned to 8 bytes already.
+    void* ptr = hdb_malloc_aligned(100, 8);
+    EXPECT_EQ((uintptr_t)ptr % 8, 0);
+    hdb_free(ptr);
+}
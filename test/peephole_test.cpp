@@ -0,0 +1,107 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+    #include <memory.h>
+    #include <chunk.h>
+    #include <peephole.h>
+}
+
+class HdbPeepholeFixture : public ::testing::Test {
+protected:
+    hdb_chunk_t chunk;
+
+    static void SetUpTestSuite() {
+        hdb_heap_init(256, 512);
+    }
+
+    static void TearDownTestSuite() {
+        hdb_heap_free();
+    }
+
+    virtual void SetUp() {
+        hdb_chunk_init(&chunk);
+    }
+
+    virtual void TearDown() {
+        hdb_chunk_free(&chunk);
+    }
+
+    void write(std::vector<uint8_t> code, int32_t line = 1) {
+        for (uint8_t byte : code) {
+            hdb_chunk_write(&chunk, byte, line);
+        }
+    }
+
+    std::vector<uint8_t> optimize() {
+        EXPECT_TRUE(hdb_peephole_optimize(&chunk));
+        return std::vector<uint8_t>(chunk.code, chunk.code + chunk.count);
+    }
+};
+
+TEST_F(HdbPeepholeFixture, not_of_boolean_constant) {
+    write({OP_TRUE, OP_NOT, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_FALSE, OP_RETURN}));
+}
+
+TEST_F(HdbPeepholeFixture, double_not_of_boolean) {
+    write({OP_FALSE, OP_NOT, OP_NOT, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_FALSE, OP_RETURN}));
+}
+
+TEST_F(HdbPeepholeFixture, double_not_of_comparison) {
+    write({OP_TWO, OP_ONE, OP_GREATER, OP_NOT, OP_NOT, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_TWO, OP_GREATER_CONSTANT, 0, OP_RETURN}));
+}
+
+TEST_F(HdbPeepholeFixture, double_not_of_other_value_is_kept) {
+    // OP_NOT raises an error for anything but a boolean, which must not disappear.
+    hdb_chunk_write_constant(&chunk, NUMBER_VAL(1.5), 1);
+    write({OP_NOT, OP_NOT, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_CONSTANT, 0, OP_NOT, OP_NOT, OP_RETURN}));
+}
+
+TEST_F(HdbPeepholeFixture, not_of_comparison) {
+    write({OP_ONE, OP_TWO, OP_SUBTRACT, OP_ZERO, OP_ONE, OP_MULTIPLY, OP_EQUAL, OP_NOT, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_ONE, OP_SUBTRACT_CONSTANT, 0, OP_ZERO, OP_MULTIPLY_CONSTANT, 1,
+                                                OP_NOT_EQUAL, OP_RETURN}));
+}
+
+TEST_F(HdbPeepholeFixture, negate_constant) {
+    hdb_chunk_write_constant(&chunk, NUMBER_VAL(1.5), 1);
+    write({OP_NEGATE, OP_RETURN});
+
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_CONSTANT, 1, OP_RETURN}));
+    EXPECT_EQ(AS_NUMBER(chunk.constants.values[1]), -1.5);
+}
+
+TEST_F(HdbPeepholeFixture, negate_small_integers) {
+    write({OP_ONE, OP_NEGATE, OP_MINUS_ONE, OP_NEGATE, OP_ZERO, OP_NEGATE, OP_TWO, OP_NEGATE, OP_RETURN});
+
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_MINUS_ONE, OP_ONE, OP_ZERO, OP_CONSTANT, 0, OP_RETURN}));
+    EXPECT_EQ(AS_INT(chunk.constants.values[0]), -2);
+}
+
+TEST_F(HdbPeepholeFixture, negated_constant_becomes_operand) {
+    hdb_chunk_write_constant(&chunk, INT_VAL(10), 1);
+    hdb_chunk_write_constant(&chunk, INT_VAL(3), 2);
+    write({OP_NEGATE}, 3);
+    write({OP_ADD}, 4);
+    write({OP_RETURN}, 5);
+
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_CONSTANT, 0, OP_ADD_CONSTANT, 2, OP_RETURN}));
+    EXPECT_EQ(AS_INT(chunk.constants.values[2]), -3);
+
+    // Errors within the addition are reported at the line of OP_ADD.
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 0), 1);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 1), 1);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 2), 2);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 3), 4);
+    EXPECT_EQ(hdb_line_decode(&chunk.lines, 4), 5);
+}
+
+TEST_F(HdbPeepholeFixture, negate_non_numeric_constant_is_kept) {
+    write({OP_TRUE, OP_NEGATE, OP_RETURN});
+    EXPECT_EQ(optimize(), std::vector<uint8_t>({OP_TRUE, OP_NEGATE, OP_RETURN}));
+}
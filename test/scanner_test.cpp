@@ -86,8 +86,8 @@ TEST_F(HdbScannerFixture, test_all_token_types) {
             {"identifier",                                      TOKEN_IDENTIFIER},
             {"`identifier`",                                    TOKEN_ENCLOSED_IDENTIFIER},
             {"\"identifier\"",                                  TOKEN_ENCLOSED_IDENTIFIER},
-            {"1",                                               TOKEN_NUMBER},
-            {"9223372036854775807",                             TOKEN_NUMBER},
+            {"1",                                               TOKEN_INTEGER_LITERAL},
+            {"9223372036854775807",                             TOKEN_INTEGER_LITERAL},
             {"1.337",                                           TOKEN_NUMBER},
             {"absolute",                                        TOKEN_ABSOLUTE},
             {"action",                                          TOKEN_ACTION},
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+
+extern "C" {
+#include <memory.h>
+#include <slab.h>
+#include "hdb_tests.h"
+}
+
+class HdbSlabFixture : public ::testing::Test {
+protected:
+    hdb_heap_view_t* heap;
+    hdb_slab_pool_t pool;
+
+    virtual void SetUp() {
+        heap = hdb_heap_init(256, 2048);
+        hdb_slab_pool_init(&pool);
+    }
+
+    virtual void TearDown() {
+        hdb_slab_pool_free(&pool);
+        hdb_heap_free();
+    }
+};
+
+TEST_F(HdbSlabFixture, hdb_slab_alloc_zero_bytes) {
+    EXPECT_EQ(hdb_slab_alloc(&pool, 0), nullptr);
+}
+
+TEST_F(HdbSlabFixture, hdb_slab_alloc_packs_objects_densely) {
+    auto first = static_cast<char*>(hdb_slab_alloc(&pool, 40));
+    auto second = static_cast<char*>(hdb_slab_alloc(&pool, 33));
+
+    // Both sizes round up to 48 bytes, so they share a slab and are adjacent.
+    EXPECT_EQ(second - first, 48);
+    EXPECT_EQ((uintptr_t)first & ~(uintptr_t)(HDB_SLAB_SIZE - 1), (uintptr_t)second & ~(uintptr_t)(HDB_SLAB_SIZE - 1));
+    EXPECT_EQ((uintptr_t)first % HDB_SLAB_GRANULARITY, 0);
+
+    // Both objects are carved from a single, aligned superblock, which is tracked in an array of 8 pointers
+    // (128 bytes).
+    auto superblock = HDB_CPP_BLOCK_PTR(pool.superblocks[0]);
+    EXPECT_EQ(pool.superblock_count, 1);
+    EXPECT_EQ((uintptr_t)pool.superblocks[0] % HDB_SLAB_SIZE, 0);
+    EXPECT_LT(HDB_BLOCK_SIZE(superblock), HDB_SLAB_SUPERBLOCK_SIZE + HDB_HEAP_PAGE_SIZE + 64);
+    EXPECT_EQ(heap->current_free, heap->current_size - HDB_BLOCK_SIZE(superblock) - 128);
+
+    hdb_slab_free(&pool, first, 40);
+    hdb_slab_free(&pool, second, 33);
+}
+
+TEST_F(HdbSlabFixture, hdb_slab_free_reuses_slot) {
+    void* first = hdb_slab_alloc(&pool, 16);
+    void* second = hdb_slab_alloc(&pool, 16);
+
+    hdb_slab_free(&pool, first, 16);
+    EXPECT_EQ(hdb_slab_alloc(&pool, 16), first);
+
+    hdb_slab_free(&pool, first, 16);
+    hdb_slab_free(&pool, second, 16);
+}
+
+TEST_F(HdbSlabFixture, hdb_slab_empty_slab_is_reused_for_other_size) {
+    void* small = hdb_slab_alloc(&pool, 16);
+    hdb_slab_free(&pool, small, 16);
+    EXPECT_EQ(pool.partial[0], nullptr);
+
+    // The slab became empty, so it is handed out again for a different size class.
+    void* large = hdb_slab_alloc(&pool, 200);
+    EXPECT_EQ(large, small);
+
+    hdb_slab_free(&pool, large, 200);
+}
+
+TEST_F(HdbSlabFixture, hdb_slab_fills_multiple_slabs) {
+    const size_t count = 1000;
+    void* objects[count];
+
+    for (auto & object : objects) {
+        object = hdb_slab_alloc(&pool, 64);
+        EXPECT_NE(object, nullptr);
+        memset(object, 0x2a, 64);
+    }
+
+    // 1000 objects of 64 bytes don't fit in a single slab.
+    EXPECT_NE((uintptr_t)objects[0] & ~(uintptr_t)(HDB_SLAB_SIZE - 1),
+              (uintptr_t)objects[count - 1] & ~(uintptr_t)(HDB_SLAB_SIZE - 1));
+
+    for (auto & object : objects) {
+        hdb_slab_free(&pool, object, 64);
+    }
+    EXPECT_EQ(pool.partial[3], nullptr);
+}
+
+TEST_F(HdbSlabFixture, hdb_slab_alloc_large_object_from_heap) {
+    void* ptr = hdb_slab_alloc(&pool, HDB_SLAB_MAX_OBJECT_SIZE + 1);
+    EXPECT_NE(ptr, nullptr);
+    EXPECT_EQ(pool.superblock_count, 0);
+
+    hdb_slab_free(&pool, ptr, HDB_SLAB_MAX_OBJECT_SIZE + 1);
+    EXPECT_EQ(heap->current_free, heap->current_size);
+}
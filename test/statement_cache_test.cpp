@@ -0,0 +1,152 @@
+#include <thread>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+    #include <memory.h>
+    #include <vm.h>
+    #include <chunk.h>
+    #include <compiler.h>
+    #include <statement_cache.h>
+}
+
+class HdbStatementCacheFixture : public ::testing::Test {
+protected:
+    const hdb_vm_t* vm;
+    hdb_statement_cache_t cache;
+
+    virtual void SetUp() {
+        hdb_vm_init(256, 512);
+        vm = hdb_vm();
+        hdb_statement_cache_init(&cache, 2);
+    }
+
+    virtual void TearDown() {
+        hdb_statement_cache_free(&cache);
+        hdb_vm_free();
+    }
+
+    // Looks up the given source in the local cache, and compiles and caches it if it misses.
+    hdb_chunk_t* lookup_or_insert(const char* source) {
+        hdb_chunk_t* cached = hdb_statement_cache_lookup(&cache, source);
+        if (cached) {
+            return cached;
+        }
+
+        hdb_chunk_t chunk;
+        hdb_chunk_init(&chunk);
+        EXPECT_TRUE(hdb_compiler_compile(source, &chunk));
+        cached = hdb_statement_cache_insert(&cache, &chunk);
+        hdb_chunk_free(&chunk);
+
+        return cached;
+    }
+};
+
+TEST_F(HdbStatementCacheFixture, repeated_statement_hits) {
+    EXPECT_EQ(hdb_vm_interpret("(1 + 2) * 3 - -4"), INTERPRET_OK);
+    EXPECT_EQ(hdb_vm_interpret("(1 + 2) * 3 - -4"), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 13);
+
+    EXPECT_EQ(vm->statement_cache.misses, 1);
+    EXPECT_EQ(vm->statement_cache.hits, 1);
+    EXPECT_EQ(vm->statement_cache.count, 1);
+}
+
+TEST_F(HdbStatementCacheFixture, whitespace_and_comments_are_ignored) {
+    EXPECT_EQ(hdb_vm_interpret("'a'+'b'"), INTERPRET_OK);
+    EXPECT_EQ(hdb_vm_interpret("  'a' +\t'b' // concatenation"), INTERPRET_OK);
+
+    EXPECT_EQ(vm->statement_cache.misses, 1);
+    EXPECT_EQ(vm->statement_cache.hits, 1);
+}
+
+TEST_F(HdbStatementCacheFixture, different_statements_miss) {
+    EXPECT_EQ(hdb_vm_interpret("1 + 2"), INTERPRET_OK);
+    EXPECT_EQ(hdb_vm_interpret("1 + 3"), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 4);
+
+    // Runtime errors are reported by line, so statements on other lines are compiled separately.
+    EXPECT_EQ(hdb_vm_interpret("1 +\n2"), INTERPRET_OK);
+
+    EXPECT_EQ(vm->statement_cache.misses, 3);
+    EXPECT_EQ(vm->statement_cache.hits, 0);
+    EXPECT_EQ(vm->statement_cache.count, 3);
+}
+
+TEST_F(HdbStatementCacheFixture, compile_errors_are_not_cached) {
+    EXPECT_EQ(hdb_vm_interpret("1 +"), INTERPRET_COMPILE_ERROR);
+    EXPECT_EQ(hdb_vm_interpret("1 +"), INTERPRET_COMPILE_ERROR);
+
+    EXPECT_EQ(vm->statement_cache.misses, 2);
+    EXPECT_EQ(vm->statement_cache.count, 0);
+}
+
+TEST_F(HdbStatementCacheFixture, cached_statement_reports_runtime_error) {
+    EXPECT_EQ(hdb_vm_interpret("1 / 0"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(hdb_vm_interpret("1 / 0"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(vm->statement_cache.hits, 1);
+}
+
+TEST_F(HdbStatementCacheFixture, evicts_least_recently_used) {
+    hdb_chunk_t* first = lookup_or_insert("1 + 2");
+    lookup_or_insert("1 + 3");
+    EXPECT_EQ(lookup_or_insert("1 + 2"), first);
+
+    // The cache holds two statements, so this evicts "1 + 3".
+    lookup_or_insert("1 + 4");
+    EXPECT_EQ(cache.count, 2);
+    EXPECT_EQ(cache.evictions, 1);
+    EXPECT_EQ(hdb_statement_cache_lookup(&cache, "1 + 2"), first);
+    EXPECT_EQ(hdb_statement_cache_lookup(&cache, "1 + 3"), nullptr);
+
+    EXPECT_EQ(cache.hits, 2);
+    EXPECT_EQ(cache.misses, 4);
+}
+
+TEST_F(HdbStatementCacheFixture, cached_chunk_outlives_compiled_chunk) {
+    hdb_chunk_t* cached = lookup_or_insert("'a' + 'b' = 'ab'");
+    ASSERT_NE(cached, nullptr);
+    EXPECT_EQ(cached->arena, nullptr);
+
+    EXPECT_EQ(hdb_vm_execute(cached, NULL, 0), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(vm->stack[vm->stack_count]));
+}
+
+TEST_F(HdbStatementCacheFixture, clear_keeps_pinned_statement) {
+    hdb_chunk_t* pinned = lookup_or_insert("1 + 2");
+    lookup_or_insert("1 + 3");
+
+    hdb_statement_cache_pin(&cache, pinned);
+    hdb_statement_cache_clear(&cache);
+    EXPECT_EQ(cache.count, 1);
+    EXPECT_EQ(hdb_statement_cache_lookup(&cache, "1 + 2"), pinned);
+
+    hdb_statement_cache_pin(&cache, nullptr);
+    hdb_statement_cache_clear(&cache);
+    EXPECT_EQ(cache.count, 0);
+}
+
+TEST_F(HdbStatementCacheFixture, disabled_cache_never_stores) {
+    hdb_statement_cache_t disabled;
+    hdb_statement_cache_init(&disabled, 0);
+
+    EXPECT_EQ(hdb_statement_cache_lookup(&disabled, "1 + 2"), nullptr);
+    EXPECT_EQ(disabled.count, 0);
+
+    hdb_statement_cache_free(&disabled);
+}
+
+TEST_F(HdbStatementCacheFixture, pressure_on_other_threads_keeps_statements) {
+    lookup_or_insert("1 + 2");
+
+    // The heap cannot grow, so allocating twice its size fails after running the pressure handlers.
+    std::thread worker([]() {
+        EXPECT_EQ(hdb_malloc(hdb_heap()->current_size * 2), nullptr);
+    });
+    worker.join();
+    EXPECT_EQ(cache.count, 1);
+
+    EXPECT_EQ(hdb_malloc(hdb_heap()->current_size * 2), nullptr);
+    EXPECT_EQ(cache.count, 0);
+}
@@ -0,0 +1,195 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+extern "C" {
+    #include <memory.h>
+    #include <vm.h>
+    #include <ustring.h>
+    #include <statement.h>
+}
+
+class HdbStatementFixture : public ::testing::Test {
+protected:
+    const hdb_vm_t* vm;
+
+    virtual void SetUp() {
+        hdb_vm_init(256, 512);
+        vm = hdb_vm();
+    }
+
+    virtual void TearDown() {
+        hdb_vm_free();
+    }
+
+    hdb_value_t result() {
+        return vm->stack[vm->stack_count];
+    }
+};
+
+TEST_F(HdbStatementFixture, execute_with_positional_parameters) {
+    hdb_statement_t* statement = hdb_statement_prepare("? * 10 + ?");
+    ASSERT_NE(statement, nullptr);
+    EXPECT_EQ(hdb_statement_parameter_count(statement), 2);
+
+    EXPECT_TRUE(hdb_statement_bind(statement, 1, INT_VAL(4)));
+    EXPECT_TRUE(hdb_statement_bind(statement, 2, INT_VAL(2)));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(result()), 42);
+
+    EXPECT_TRUE(hdb_statement_bind(statement, 2, NUMBER_VAL(0.5)));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_EQ(AS_NUMBER(result()), 40.5);
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, named_parameters_share_an_index) {
+    hdb_statement_t* statement = hdb_statement_prepare(":a * :a - :b");
+    ASSERT_NE(statement, nullptr);
+    EXPECT_EQ(hdb_statement_parameter_count(statement), 2);
+    EXPECT_EQ(hdb_statement_parameter_index(statement, "a"), 1);
+    EXPECT_EQ(hdb_statement_parameter_index(statement, "b"), 2);
+    EXPECT_EQ(hdb_statement_parameter_index(statement, "c"), 0);
+
+    hdb_statement_bind(statement, hdb_statement_parameter_index(statement, "a"), INT_VAL(7));
+    hdb_statement_bind(statement, hdb_statement_parameter_index(statement, "b"), INT_VAL(7));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(result()), 42);
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, bind_string) {
+    hdb_statement_t* statement = hdb_statement_prepare("? + 'b' = 'ab'");
+    ASSERT_NE(statement, nullptr);
+
+    hdb_statement_bind(statement, 1, OBJ_VAL(hdb_ustring_create("a")));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(result()));
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, unbound_parameters_are_null) {
+    hdb_statement_t* statement = hdb_statement_prepare("? = null");
+    ASSERT_NE(statement, nullptr);
+
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(result()));
+
+    hdb_statement_bind(statement, 1, INT_VAL(1));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_FALSE(AS_BOOL(result()));
+
+    hdb_statement_clear_bindings(statement);
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(result()));
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, bind_out_of_range) {
+    hdb_statement_t* statement = hdb_statement_prepare("?");
+    ASSERT_NE(statement, nullptr);
+
+    EXPECT_FALSE(hdb_statement_bind(statement, 0, INT_VAL(1)));
+    EXPECT_FALSE(hdb_statement_bind(statement, 2, INT_VAL(1)));
+    EXPECT_TRUE(hdb_statement_bind(statement, 1, INT_VAL(1)));
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, runtime_error_within_statement) {
+    hdb_statement_t* statement = hdb_statement_prepare("-?");
+    ASSERT_NE(statement, nullptr);
+
+    hdb_statement_bind(statement, 1, BOOL_VAL(true));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_RUNTIME_ERROR);
+
+    hdb_statement_bind(statement, 1, INT_VAL(3));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(result()), -3);
+
+    hdb_statement_finalize(statement);
+}
+
+TEST_F(HdbStatementFixture, prepare_compile_error) {
+    EXPECT_EQ(hdb_statement_prepare("? +"), nullptr);
+    EXPECT_EQ(hdb_statement_prepare(": + 1"), nullptr);
+}
+
+TEST_F(HdbStatementFixture, prepare_uses_statement_cache) {
+    hdb_statement_t* first = hdb_statement_prepare("? + 1");
+    hdb_statement_t* second = hdb_statement_prepare("?  +  1");
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+
+    EXPECT_EQ(vm->statement_cache.misses, 1);
+    EXPECT_EQ(vm->statement_cache.hits, 1);
+
+    // Both statements have their own bindings.
+    hdb_statement_bind(first, 1, INT_VAL(1));
+    hdb_statement_bind(second, 1, INT_VAL(2));
+    EXPECT_EQ(hdb_statement_execute(first), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(result()), 2);
+    EXPECT_EQ(hdb_statement_execute(second), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(result()), 3);
+
+    hdb_statement_finalize(first);
+    hdb_statement_finalize(second);
+}
+
+static std::vector<void*> exhaust_heap() {
+    std::vector<void*> blocks;
+
+    for (size_t size = hdb_heap()->current_size; size > 0; size /= 2) {
+        void* block;
+        while ((block = hdb_malloc(size)) != nullptr) {
+            blocks.push_back(block);
+        }
+    }
+
+    return blocks;
+}
+
+static bool release_blocks(size_t size, void* context) {
+    auto blocks = static_cast<std::vector<void*>*>(context);
+    for (auto block : *blocks) {
+        hdb_free(block);
+    }
+    blocks->clear();
+
+    return true;
+}
+
+TEST_F(HdbStatementFixture, prepare_keeps_cached_statement_under_pressure) {
+    const char* source = "'a' + ? = 'ab'";
+    hdb_statement_finalize(hdb_statement_prepare(source));
+
+    // Fill the heap without the cache evicting the statement, so copying it from the cache runs out of memory.
+    auto cache = const_cast<hdb_statement_cache_t*>(&vm->statement_cache);
+    hdb_statement_cache_pin(cache, hdb_statement_cache_lookup(cache, source));
+    std::vector<void*> blocks = exhaust_heap();
+    hdb_statement_cache_pin(cache, nullptr);
+    ASSERT_TRUE(hdb_heap_pressure_register(release_blocks, &blocks, 1));
+
+    // The cache cannot relieve the pressure with the statement that is being copied.
+    hdb_statement_t* statement = hdb_statement_prepare(source);
+    ASSERT_NE(statement, nullptr);
+    EXPECT_TRUE(blocks.empty());
+    EXPECT_EQ(vm->statement_cache.count, 1);
+    EXPECT_EQ(vm->statement_cache.evictions, 0);
+
+    hdb_statement_bind(statement, 1, OBJ_VAL(hdb_ustring_create("b")));
+    EXPECT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(result()));
+
+    hdb_statement_finalize(statement);
+    hdb_heap_pressure_unregister(release_blocks, &blocks);
+}
+
+TEST_F(HdbStatementFixture, interpret_without_bindings) {
+    EXPECT_EQ(hdb_vm_interpret("? = null"), INTERPRET_OK);
+    EXPECT_TRUE(AS_BOOL(result()));
+}
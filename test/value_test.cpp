@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "gtest/gtest.h"
 
 extern "C" {
@@ -53,4 +55,55 @@ TEST_F(HdbValueFixture, force_value_array_grow) {
     for (int i = 0; i < values->count; i++) {
         EXPECT_EQ(AS_NUMBER(values->values[i]), 1.0 * i);
     }
-}
\ No newline at end of file
+}
+
+TEST_F(HdbValueFixture, value_predicates) {
+    hdb_object_t* object = (hdb_object_t*)values;
+
+    EXPECT_TRUE(IS_NULL(NULL_VAL));
+    EXPECT_TRUE(IS_BOOL(BOOL_VAL(true)));
+    EXPECT_TRUE(IS_BOOL(BOOL_VAL(false)));
+    EXPECT_TRUE(IS_NUMBER(NUMBER_VAL(-1.337)));
+    EXPECT_TRUE(IS_INT(INT_VAL(-42)));
+    EXPECT_TRUE(IS_OBJ(OBJ_VAL(object)));
+
+    EXPECT_FALSE(IS_NUMBER(NULL_VAL));
+    EXPECT_FALSE(IS_BOOL(NULL_VAL));
+    EXPECT_FALSE(IS_NULL(BOOL_VAL(false)));
+    EXPECT_FALSE(IS_BOOL(NUMBER_VAL(0)));
+    EXPECT_FALSE(IS_OBJ(NUMBER_VAL(-0.0)));
+    EXPECT_FALSE(IS_NUMBER(OBJ_VAL(object)));
+    EXPECT_FALSE(IS_NUMBER(INT_VAL(1)));
+    EXPECT_FALSE(IS_INT(NUMBER_VAL(1.0)));
+    EXPECT_FALSE(IS_INT(OBJ_VAL(object)));
+    EXPECT_FALSE(IS_BOOL(INT_VAL(1)));
+
+    EXPECT_EQ(AS_BOOL(BOOL_VAL(true)), true);
+    EXPECT_EQ(AS_BOOL(BOOL_VAL(false)), false);
+    EXPECT_EQ(AS_NUMBER(NUMBER_VAL(-1.337)), -1.337);
+    EXPECT_EQ(AS_OBJ(OBJ_VAL(object)), object);
+    EXPECT_EQ(AS_INT(INT_VAL(-42)), -42);
+    EXPECT_EQ(AS_INT(INT_VAL(HDB_INT_MIN)), HDB_INT_MIN);
+    EXPECT_EQ(AS_INT(INT_VAL(HDB_INT_MAX)), HDB_INT_MAX);
+}
+
+TEST_F(HdbValueFixture, values_equal) {
+    EXPECT_TRUE(hdb_values_equal(NULL_VAL, NULL_VAL));
+    EXPECT_TRUE(hdb_values_equal(BOOL_VAL(true), BOOL_VAL(true)));
+    EXPECT_TRUE(hdb_values_equal(NUMBER_VAL(0.0), NUMBER_VAL(-0.0)));
+    EXPECT_TRUE(hdb_values_equal(INT_VAL(3), INT_VAL(3)));
+    EXPECT_TRUE(hdb_values_equal(INT_VAL(3), NUMBER_VAL(3.0)));
+
+    EXPECT_FALSE(hdb_values_equal(BOOL_VAL(true), BOOL_VAL(false)));
+    EXPECT_FALSE(hdb_values_equal(NULL_VAL, BOOL_VAL(false)));
+    EXPECT_FALSE(hdb_values_equal(NUMBER_VAL(0.0), BOOL_VAL(false)));
+    EXPECT_FALSE(hdb_values_equal(INT_VAL(0), BOOL_VAL(false)));
+    EXPECT_FALSE(hdb_values_equal(INT_VAL(3), NUMBER_VAL(3.5)));
+    EXPECT_FALSE(hdb_values_equal(NUMBER_VAL(NAN), NUMBER_VAL(NAN)));
+}
+
+#ifdef HDB_NAN_BOXING
+TEST_F(HdbValueFixture, nan_boxed_value_size) {
+    EXPECT_EQ(sizeof(hdb_value_t), 8);
+}
+#endif
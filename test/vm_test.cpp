@@ -1,3 +1,7 @@
+#include <cerrno>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 extern "C" {
@@ -8,6 +12,7 @@ extern "C" {
 #include <chunk.h>
 #include <object.h>
 #include <ustring.h>
+#include <statement.h>
 }
 
 class HdbVMFixture : public ::testing::Test {
@@ -23,6 +28,18 @@ protected:
         hdb_vm_free();
     }
 
+    // Writes a chunk that adds the given amount of distinct constants, of which all but the first 256 are loaded
+    // through OP_CONSTANT_LONG.
+    static void write_constant_sum(hdb_chunk_t* chunk, int32_t constant_count) {
+        hdb_chunk_write_constant(chunk, INT_VAL(0), 1);
+        for (int32_t i = 1; i < constant_count; i++) {
+            hdb_chunk_write_constant(chunk, INT_VAL(i), 1);
+            hdb_chunk_write(chunk, OP_ADD, 1);
+        }
+        hdb_chunk_write(chunk, OP_RETURN, 1);
+        chunk->stack_high_water_mark = 2;
+    }
+
 
     timespec diff(timespec start, timespec end)
     {
@@ -47,7 +64,8 @@ TEST_F(HdbVMFixture, hdb_validate_precedence) {
     hdb_interpret_result_t result = hdb_vm_interpret(source);
 
     EXPECT_EQ(result, INTERPRET_OK);
-    EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), 7);
+    EXPECT_TRUE(IS_INT(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 7);
 }
 
 TEST_F(HdbVMFixture, hdb_negate_value) {
@@ -98,6 +116,93 @@ TEST_F(HdbVMFixture, hdb_binary_op_mix) {
     EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), -((1.337 + 0.663) / 100));
 }
 
+TEST_F(HdbVMFixture, hdb_integer_arithmetic) {
+    EXPECT_EQ(hdb_vm_interpret("7 * 6 - 3 + 9"), INTERPRET_OK);
+    EXPECT_TRUE(IS_INT(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 48);
+
+    EXPECT_EQ(hdb_vm_interpret("-7 / 2"), INTERPRET_OK);
+    EXPECT_TRUE(IS_INT(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), -3);
+}
+
+TEST_F(HdbVMFixture, hdb_integer_promotes_to_double) {
+    EXPECT_EQ(hdb_vm_interpret("7 / 2.0"), INTERPRET_OK);
+    EXPECT_TRUE(IS_NUMBER(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), 3.5);
+
+    EXPECT_EQ(hdb_vm_interpret("1.5 + 1"), INTERPRET_OK);
+    EXPECT_TRUE(IS_NUMBER(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), 2.5);
+}
+
+TEST_F(HdbVMFixture, hdb_integer_overflow_promotes_to_double) {
+    std::string max = std::to_string(HDB_INT_MAX);
+
+    EXPECT_EQ(hdb_vm_interpret((max + " + 1").c_str()), INTERPRET_OK);
+    EXPECT_TRUE(IS_NUMBER(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), (double)HDB_INT_MAX + 1);
+
+    EXPECT_EQ(hdb_vm_interpret((max + " * -2").c_str()), INTERPRET_OK);
+    EXPECT_TRUE(IS_NUMBER(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_NUMBER(vm->stack[vm->stack_count]), (double)HDB_INT_MAX * -2);
+
+    EXPECT_EQ(hdb_vm_interpret((max + " + 0").c_str()), INTERPRET_OK);
+    EXPECT_TRUE(IS_INT(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), HDB_INT_MAX);
+}
+
+TEST_F(HdbVMFixture, hdb_division_by_zero_is_an_error) {
+    EXPECT_EQ(hdb_vm_interpret("1 / 0"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(hdb_vm_interpret("1.5 / 0"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(hdb_vm_interpret("1 / 0.0"), INTERPRET_RUNTIME_ERROR);
+}
+
+TEST_F(HdbVMFixture, hdb_compare_numbers) {
+    EXPECT_EQ(hdb_vm_interpret("3 < 4"), INTERPRET_OK);
+    EXPECT_TRUE(IS_BOOL(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+
+    EXPECT_EQ(hdb_vm_interpret("3 >= 3.5"), INTERPRET_OK);
+    EXPECT_TRUE(IS_BOOL(vm->stack[vm->stack_count]));
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), false);
+}
+
+TEST_F(HdbVMFixture, hdb_superinstructions) {
+    EXPECT_EQ(hdb_vm_interpret("10 - 1 * 2 / 2 >= 9"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+
+    EXPECT_EQ(hdb_vm_interpret("!(3 > 4 * 1)"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+
+    EXPECT_EQ(hdb_vm_interpret("!(3 < -4)"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+
+    EXPECT_EQ(hdb_vm_interpret("'a' + 'b' <> 'ab'"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), false);
+
+    EXPECT_EQ(hdb_vm_interpret("1 / 0"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(hdb_vm_interpret("!(true > 1)"), INTERPRET_RUNTIME_ERROR);
+}
+
+TEST_F(HdbVMFixture, hdb_execute_long_constants) {
+    hdb_chunk_t chunk;
+    hdb_chunk_init(&chunk);
+    write_constant_sum(&chunk, 1000);
+
+    EXPECT_EQ(hdb_vm_execute(&chunk, NULL, 0), INTERPRET_OK);
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 999 * 1000 / 2);
+    hdb_chunk_free(&chunk);
+}
+
+TEST_F(HdbVMFixture, hdb_equals_integer_and_double) {
+    EXPECT_EQ(hdb_vm_interpret("2 = 2.0"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+
+    EXPECT_EQ(hdb_vm_interpret("3 <> 3.5"), INTERPRET_OK);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+}
+
 TEST_F(HdbVMFixture, hdb_equals_different_types) {
     const char* source = "1 = false";
     hdb_interpret_result_t result = hdb_vm_interpret(source);
@@ -160,8 +265,91 @@ TEST_F(HdbVMFixture, hdb_string_concatenation) {
     EXPECT_STREQ(AS_CSTRING(value), "string");
 }
 
+TEST_F(HdbVMFixture, hdb_string_concatenation_within_expression) {
+    const char* source = "1 + 2 = 3 = ('a' + 'b' = 'ab')";
+    hdb_interpret_result_t result = hdb_vm_interpret(source);
+
+    EXPECT_EQ(result, INTERPRET_OK);
+    EXPECT_EQ(vm->stack_count, 0);
+    EXPECT_EQ(AS_BOOL(vm->stack[vm->stack_count]), true);
+}
+
+TEST_F(HdbVMFixture, hdb_runtime_error_resets_stack) {
+    EXPECT_EQ(hdb_vm_interpret("1 + (2 * -true)"), INTERPRET_RUNTIME_ERROR);
+    EXPECT_EQ(vm->stack_count, 0);
+
+    EXPECT_EQ(hdb_vm_interpret("1 + 2"), INTERPRET_OK);
+    EXPECT_EQ(vm->stack_count, 0);
+    EXPECT_EQ(AS_INT(vm->stack[vm->stack_count]), 3);
+}
+
+/*
+ * Allocates blocks until the heap is exhausted, and returns them in a vector.
+ */
+static std::vector<void*> exhaust_heap() {
+    std::vector<void*> blocks;
+
+    for (size_t size = hdb_heap()->current_size; size > 0; size /= 2) {
+        void* block;
+        while ((block = hdb_malloc(size)) != nullptr) {
+            blocks.push_back(block);
+        }
+    }
+
+    return blocks;
+}
+
+static bool release_blocks(size_t size, void* context) {
+    auto blocks = static_cast<std::vector<void*>*>(context);
+    for (auto block : *blocks) {
+        hdb_free(block);
+    }
+    blocks->clear();
+
+    return true;
+}
+
+TEST_F(HdbVMFixture, hdb_trace_execution) {
+    hdb_vm_trace(true);
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(hdb_vm_interpret("1 + -2"), INTERPRET_OK);
+    std::string traced = testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(traced.find("OP_RETURN"), std::string::npos);
+    EXPECT_NE(traced.find("[ -1 ]"), std::string::npos);
+
+    hdb_vm_trace(false);
+    testing::internal::CaptureStdout();
+    EXPECT_EQ(hdb_vm_interpret("1 + -2"), INTERPRET_OK);
+    traced = testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(traced.find("[ -1 ]"), std::string::npos);
+}
+
+TEST_F(HdbVMFixture, hdb_out_of_memory_is_an_error) {
+    std::vector<void*> blocks = exhaust_heap();
+    EXPECT_EQ(errno, ENOMEM);
+
+    // The chunk cannot be compiled without memory, but the process survives.
+    EXPECT_EQ(hdb_vm_interpret("1 + 2"), INTERPRET_COMPILE_ERROR);
+
+    release_blocks(0, &blocks);
+    EXPECT_EQ(hdb_vm_interpret("1 + 2"), INTERPRET_OK);
+}
+
+TEST_F(HdbVMFixture, hdb_pressure_handler_relieves_interpret) {
+    std::vector<void*> blocks = exhaust_heap();
+    ASSERT_TRUE(hdb_heap_pressure_register(release_blocks, &blocks, 0));
+
+    EXPECT_EQ(hdb_vm_interpret("'str' + 'ing'"), INTERPRET_OK);
+    EXPECT_TRUE(blocks.empty());
+    EXPECT_STREQ(AS_CSTRING(vm->stack[vm->stack_count]), "string");
+
+    hdb_heap_pressure_unregister(release_blocks, &blocks);
+}
+
 TEST_F(HdbVMFixture, DISABLED_hdb_vm_interpretation_performance) {
-    // Only run this test when DEBUG_TRACE_EXECUTION and DEBUG_PRINT_CODE are off! see common.h
+    // Only run this test in a build without HDB_DEBUG_TRACE_EXECUTION and HDB_DEBUG_PRINT_CODE
 
     const char* source = "(-1 + 2) * 3 - -4";
     int32_t sz = 20000000;
@@ -179,4 +367,61 @@ TEST_F(HdbVMFixture, DISABLED_hdb_vm_interpretation_performance) {
     ulong ns = (d.tv_sec * 1000000000 + d.tv_nsec);
 #endif
     printf("Duration per chunk: %luns\n", ns / sz);
-}
\ No newline at end of file
+}
+
+TEST_F(HdbVMFixture, DISABLED_hdb_vm_constant_performance) {
+    // Only run this test in a build without HDB_DEBUG_TRACE_EXECUTION and HDB_DEBUG_PRINT_CODE.
+    // Executes a compiled chunk directly, so only loading the constants and adding them up is measured.
+    // Most of its constants are loaded through OP_CONSTANT_LONG.
+    hdb_chunk_t chunk;
+    hdb_chunk_init(&chunk);
+    write_constant_sum(&chunk, 4096);
+
+    int32_t sz = 20000;
+    timespec start, finish;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (int32_t i = 0; i < sz; i++) {
+        ASSERT_EQ(hdb_vm_execute(&chunk, NULL, 0), INTERPRET_OK);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &finish);
+    hdb_chunk_free(&chunk);
+
+    timespec d = diff(start, finish);
+#ifdef __APPLE__
+    u_long ns = (d.tv_sec * 1000000000 + d.tv_nsec);
+#else
+    ulong ns = (d.tv_sec * 1000000000 + d.tv_nsec);
+#endif
+    printf("Duration per 4096 constants: %luns\n", ns / sz);
+}
+
+TEST_F(HdbVMFixture, DISABLED_hdb_vm_dispatch_performance) {
+    // Compare a default build against one configured with -DHDB_VM_SWITCH_DISPATCH=ON, both without
+    // HDB_DEBUG_TRACE_EXECUTION and HDB_DEBUG_PRINT_CODE. The expression is prepared once, so only its execution is
+    // measured. Every other operand is a parameter, which keeps the compiler from folding the expression.
+    std::string source = ":x";
+    for (int32_t i = 0; i < 250; i++) {
+        source += (i % 4 == 0) ? " + :x" : (i % 4 == 1) ? " * 1.5" : (i % 4 == 2) ? " - :x" : " / 1.25";
+    }
+
+    hdb_statement_t* statement = hdb_statement_prepare(source.c_str());
+    ASSERT_NE(statement, nullptr);
+    hdb_statement_bind(statement, hdb_statement_parameter_index(statement, "x"), INT_VAL(2));
+
+    int32_t sz = 1000000;
+    timespec start, finish;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+    for (int32_t i = 0; i < sz; i++) {
+        ASSERT_EQ(hdb_statement_execute(statement), INTERPRET_OK);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &finish);
+    hdb_statement_finalize(statement);
+
+    timespec d = diff(start, finish);
+#ifdef __APPLE__
+    u_long ns = (d.tv_sec * 1000000000 + d.tv_nsec);
+#else
+    ulong ns = (d.tv_sec * 1000000000 + d.tv_nsec);
+#endif
+    printf("Duration per expression of 250 operators: %luns\n", ns / sz);
+}
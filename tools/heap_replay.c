@@ -0,0 +1,307 @@
+/**
+ * Replays an allocation trace recorded with \c hdb_heap_trace_start() against several allocators, and reports the
+ * time each of them takes and their peak footprint.
+ *
+ * Usage: hdb_heap_replay <trace>
+ *
+ * Every allocator replays the trace in a separate child process, so the peak resident set size reported by the OS
+ * only reflects that allocator.
+ *
+ * \since 0.0.1
+ * \author houthacker
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "memory.h"
+
+#define NO_SLOT ((size_t)-1)
+
+/**
+ * An allocator a trace can be replayed against.
+ */
+typedef struct replay_allocator {
+
+    /**
+     * The name of the allocator in the report.
+     */
+    const char* name;
+
+    void (*init)(void);
+    void* (*malloc)(size_t size);
+    void (*free)(void* ptr);
+    void* (*realloc)(void* ptr, size_t size);
+} replay_allocator_t;
+
+/**
+ * A trace operation, with the addresses of the trace translated to slots of the replay.
+ */
+typedef struct replay_operation {
+
+    /**
+     * One of the HDB_HEAP_TRACE_* operations.
+     */
+    uint8_t operation;
+
+    /**
+     * The requested size in bytes.
+     */
+    size_t size;
+
+    /**
+     * The slot receiving the result of the operation, or NO_SLOT.
+     */
+    size_t result;
+
+    /**
+     * The slot of the pointer the operation takes, or NO_SLOT.
+     */
+    size_t argument;
+} replay_operation_t;
+
+static void hdb_init(void) {
+    if (!hdb_heap_init(HDB_HEAP_INITIAL_MIN_SIZE, (size_t)1 << 40)) {
+        perror("hdb_heap_init");
+        exit(1);
+    }
+}
+
+static void libc_init(void) {
+}
+
+static const replay_allocator_t allocators[] = {
+        {"hdb", hdb_init, hdb_malloc, hdb_free, hdb_reallocate},
+        {"libc", libc_init, malloc, free, realloc},
+};
+
+/*
+ * A hash table from trace addresses to the slot of the allocation currently living at that address.
+ * It uses linear probing, and removes entries by shifting their successors back.
+ */
+typedef struct address_table {
+    uint64_t* addresses;
+    size_t* slots;
+    size_t mask;
+} address_table_t;
+
+static size_t address_hash(address_table_t* table, uint64_t address) {
+    return (size_t)((address >> 4) * 0x9E3779B97F4A7C15ull) & table->mask;
+}
+
+static void address_put(address_table_t* table, uint64_t address, size_t slot) {
+    size_t index = address_hash(table, address);
+    while (table->addresses[index] && table->addresses[index] != address) {
+        index = (index + 1) & table->mask;
+    }
+
+    table->addresses[index] = address;
+    table->slots[index] = slot;
+}
+
+static size_t address_remove(address_table_t* table, uint64_t address) {
+    size_t index = address_hash(table, address);
+    while (table->addresses[index] != address) {
+        if (!table->addresses[index]) {
+            return NO_SLOT;
+        }
+        index = (index + 1) & table->mask;
+    }
+
+    const size_t slot = table->slots[index];
+    table->addresses[index] = 0;
+
+    // Move back entries which would otherwise become unreachable because of the gap.
+    size_t next = (index + 1) & table->mask;
+    while (table->addresses[next]) {
+        const size_t home = address_hash(table, table->addresses[next]);
+        if (((next - home) & table->mask) >= ((next - index) & table->mask)) {
+            table->addresses[index] = table->addresses[next];
+            table->slots[index] = table->slots[next];
+            table->addresses[next] = 0;
+            index = next;
+        }
+        next = (next + 1) & table->mask;
+    }
+
+    return slot;
+}
+
+/*
+ * Reads the trace at the given path, and translates its addresses to slots. Returns the amount of operations, and
+ * stores the peak amount of requested bytes alive at once in peak_requested.
+ */
+static size_t load_trace(const char* path, replay_operation_t** operations, size_t* peak_requested) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+
+    fseek(file, 0L, SEEK_END);
+    const size_t count = (size_t)ftell(file) / sizeof(hdb_heap_trace_record_t);
+    rewind(file);
+
+    hdb_heap_trace_record_t* records = malloc(count * sizeof(hdb_heap_trace_record_t) + 1);
+    if (fread(records, sizeof(hdb_heap_trace_record_t), count, file) < count) {
+        fprintf(stderr, "Could not read trace \"%s\".\n", path);
+        exit(1);
+    }
+    fclose(file);
+
+    size_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+
+    address_table_t table = {
+            .addresses = calloc(capacity, sizeof(uint64_t)),
+            .slots = calloc(capacity, sizeof(size_t)),
+            .mask = capacity - 1
+    };
+    size_t* sizes = calloc(count + 1, sizeof(size_t));
+    *operations = malloc(count * sizeof(replay_operation_t) + 1);
+
+    size_t requested = 0;
+    *peak_requested = 0;
+    for (size_t i = 0; i < count; i++) {
+        hdb_heap_trace_record_t* record = &records[i];
+        replay_operation_t* operation = &(*operations)[i];
+
+        operation->operation = record->operation;
+        operation->size = record->size;
+        operation->result = NO_SLOT;
+        operation->argument = NO_SLOT;
+
+        if (record->operation == HDB_HEAP_TRACE_FREE || record->operation == HDB_HEAP_TRACE_REALLOCATE) {
+            if (record->previous || record->operation == HDB_HEAP_TRACE_FREE) {
+                const uint64_t address = record->operation == HDB_HEAP_TRACE_FREE
+                        ? record->address
+                        : record->previous;
+                operation->argument = address_remove(&table, address);
+                if (operation->argument != NO_SLOT) {
+                    requested -= sizes[operation->argument];
+                }
+            }
+        }
+
+        if (record->operation != HDB_HEAP_TRACE_FREE && record->address) {
+            operation->result = i;
+            sizes[i] = record->size;
+            requested += record->size;
+            address_put(&table, record->address, i);
+        }
+
+        if (requested > *peak_requested) {
+            *peak_requested = requested;
+        }
+    }
+
+    free(sizes);
+    free(table.slots);
+    free(table.addresses);
+    free(records);
+
+    return count;
+}
+
+/*
+ * Writes a byte to every page of the given allocation, like a program using the memory would.
+ */
+static void touch(void* ptr, size_t size) {
+    for (size_t offset = 0; offset < size; offset += 4096) {
+        ((volatile char*)ptr)[offset] = 1;
+    }
+}
+
+/*
+ * Replays the given operations against the given allocator, and returns the elapsed time in seconds.
+ */
+static double replay(const replay_allocator_t* allocator, replay_operation_t* operations, size_t count) {
+    void** slots = calloc(count + 1, sizeof(void*));
+    struct timespec start, end;
+
+    allocator->init();
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < count; i++) {
+        replay_operation_t* operation = &operations[i];
+        void* argument = operation->argument == NO_SLOT ? NULL : slots[operation->argument];
+        void* result = NULL;
+
+        switch (operation->operation) {
+            case HDB_HEAP_TRACE_MALLOC:
+                result = allocator->malloc(operation->size);
+                touch(result, operation->size);
+                break;
+            case HDB_HEAP_TRACE_FREE:
+                allocator->free(argument);
+                break;
+            case HDB_HEAP_TRACE_REALLOCATE:
+                result = allocator->realloc(argument, operation->size);
+                touch(result, operation->size);
+                break;
+            default:
+                break;
+        }
+
+        if (operation->result != NO_SLOT) {
+            slots[operation->result] = result;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(slots);
+
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, const char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: hdb_heap_replay <trace>\n");
+        return 64;
+    }
+
+    replay_operation_t* operations;
+    size_t peak_requested;
+    const size_t count = load_trace(argv[1], &operations, &peak_requested);
+
+    printf("%zu operations, peak of %zu requested bytes alive\n", count, peak_requested);
+    printf("%-10s %12s %16s\n", "allocator", "time (ms)", "peak rss (KB)");
+
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            return 1;
+        }
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            double elapsed = replay(&allocators[i], operations, count);
+            ssize_t written = write(fds[1], &elapsed, sizeof(elapsed));
+            _exit(written == sizeof(elapsed) ? 0 : 1);
+        }
+        close(fds[1]);
+
+        double elapsed = -1;
+        int status;
+        struct rusage usage;
+        if (pid < 0 || read(fds[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed)
+                || wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Replay with %s failed.\n", allocators[i].name);
+            return 1;
+        }
+        close(fds[0]);
+
+        printf("%-10s %12.3f %16ld\n", allocators[i].name, elapsed * 1000, usage.ru_maxrss);
+    }
+
+    free(operations);
+    return 0;
+}